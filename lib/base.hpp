@@ -63,6 +63,72 @@
 
 typedef char tchar;
 
+/* x86 instruction set extensions, detected once at runtime by CPUID; code using them is compiled per function with
+   TARGET_ISA, so the binary keeps running on hosts without them                                                       */
+#if defined __x86_64__ || defined __i386__ || defined _M_X64 || defined _M_IX86
+    #define ISA_X86 true
+    #if defined _MSC_VER
+        #include <intrin.h>
+        #define TARGET_ISA( isa)
+    #else
+        #include <cpuid.h>
+        #define TARGET_ISA( isa) __attribute__(( target( isa)))
+    #endif
+#else
+    #define ISA_X86 false
+    #define TARGET_ISA( isa)
+#endif
+
+struct CpuFeatures {
+    bool ssse3  = false;
+    bool sse41  = false;
+    bool sha_ni = false;
+    bool avx2   = false;
+    bool avx512 = false; // AVX-512 F
+private:
+    CpuFeatures() noexcept {
+#if ISA_X86
+        u32 r[4] = { 0 }; // eax, ebx, ecx, edx
+        const u32 max_leaf = cpuid( 0, r)[0];
+        cpuid( 1, r);
+        ssse3  = r[2] & (1u << 9);
+        sse41  = r[2] & (1u << 19);
+        // the OS must save the ymm / zmm registers on context switch, else AVX is unusable
+        const u64 xcr0 = (r[2] & (1u << 27)) ? xgetbv() : 0;
+        if (max_leaf >= 7) {
+            cpuid( 7, r);
+            sha_ni = ssse3 && sse41 && (r[1] & (1u << 29));
+            avx2   = (xcr0 & 0x06) == 0x06 && (r[1] & (1u << 5));
+            avx512 = (xcr0 & 0xe6) == 0xe6 && (r[1] & (1u << 16)) && avx2;
+        }
+#endif
+    }
+#if ISA_X86
+    static const u32* cpuid( const u32 leaf, u32 (&r)[4]) noexcept {
+    #if defined _MSC_VER
+        __cpuidex( (int*)r, leaf, 0);
+    #else
+        __cpuid_count( leaf, 0, r[0], r[1], r[2], r[3]);
+    #endif
+        return r;
+    }
+    static u64 xgetbv() noexcept {
+    #if defined _MSC_VER
+        return _xgetbv( 0);
+    #else
+        u32 lo, hi;
+        __asm__( "xgetbv" : "=a"( lo), "=d"( hi) : "c"( 0));
+        return ((u64)hi << 32) | lo;
+    #endif
+    }
+#endif
+public:
+    static const CpuFeatures& get() noexcept {
+        static const CpuFeatures features;
+        return features;
+    }
+};
+
 class Static {
 protected:
     constexpr Static() noexcept { };
@@ -0,0 +1,400 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Binary manifest: a header, the records of fixed width with the raw digest in the order written, a string table of      *
+ *   the directory and file names, each stored once, an index of (hash of the path, record) sorted by the hash and an       *
+ *   index of the records sorted by digest. The file is mapped by the reader, a path or a digest is found by binary         *
+ *   search, without parsing anything. Written to path.tmp, renamed over path when complete.                                *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef binmanifest_hpp
+#define binmanifest_hpp
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "base.hpp"
+#include "io.hpp"
+
+VERSION( binmanifest_hpp, 0, 1, 0, 0);
+
+class BinaryManifest : Independent {
+public:
+    static constexpr char cMagic[8] = { 'S', '2', '5', '6', 'M', 'A', 'N', '1' };
+    static constexpr u16  cHashed      = 1;  // flags: the digest is valid
+    static constexpr u16  cError       = 2;  //        size holds the errno of the file
+    static constexpr u16  cSizeUnknown = 4;  //        no size, of a line of a sha256sum list
+
+    struct Header {
+        char magic[8];
+        u32  record_size;
+        u32  reserved;
+        u64  count;         // records, following the header
+        u64  strings;       // offset and size of the string table
+        u64  strings_size;
+        u64  path_index;    // offset of count PathKey, sorted
+        u64  digest_index;  // offset of count u64 record numbers, sorted by digest
+        u64  check;         // of the bytes in front
+    };
+    struct Record {
+        u8   digest[32];
+        u64  size;
+        u64  dir;   // offsets in the string table
+        u64  name;
+        char type[4];
+        i16  mode;  // -1 if none
+        u16  flags;
+    };
+    struct PathKey {
+        u64 hash;
+        u64 record;
+    };
+    static_assert( sizeof( Header) == 64 && sizeof( Record) == 64, "binary manifest layout");
+
+    static u64 fnv(const void* p_data, const u64 p_len, u64 p_h = 14695981039346656037ull) noexcept {  // FNV-1a
+        for (const u8* p = (const u8*)p_data; p < (const u8*)p_data + p_len; p++)
+            p_h = (p_h ^ *p) * 1099511628211ull;
+        return p_h;
+    }
+    /* description:    the hash of the path p_dir / p_name, as indexed                                              */
+    static u64 pathHash(const char* p_dir, const char* p_name) noexcept {
+        return fnv( p_name, strlen( p_name), fnv( "/", 1, fnv( p_dir, strlen( p_dir))));
+    }
+    static u64 headerCheck(const Header &p_h) noexcept { return fnv( &p_h, offsetof( Header, check)); }
+
+private:
+    int m_fd = -1;
+    const u8* m_map = nullptr;
+    u64 m_map_size = 0;
+    const Header* m_header = nullptr;
+    const Record* m_records = nullptr;
+    const char* m_strings = nullptr;
+    const PathKey* m_paths = nullptr;
+    const u64* m_digests = nullptr;
+
+    bool within(const u64 p_offset, const u64 p_len) const noexcept {
+        return p_offset <= m_map_size && p_len <= m_map_size - p_offset;
+    }
+public:
+    /* description:    true, if the file p_path starts as a binary manifest                                        */
+    static bool is(const char* p_path) noexcept {
+        char magic[sizeof( cMagic)];
+        const int fd = ::open( p_path, O_RDONLY | O_CLOEXEC);
+        if ( fd < 0)
+            return false;
+        const bool is = ::read( fd, magic, sizeof( magic)) == sizeof( magic) && memcmp( magic, cMagic, sizeof( magic)) == 0;
+        ::close( fd);
+        return is;
+    }
+
+    /* description:    maps the binary manifest p_path
+       error:          errno of opening or mapping it, EINVAL if it is none or broken                              */
+    explicit BinaryManifest(const char* p_path) {
+        m_fd = ::open( p_path, O_RDONLY | O_CLOEXEC);
+        struct stat sb;
+        if ( m_fd < 0 || fstat( m_fd, &sb) != 0)
+            throw new _Exception( errno, "binary manifest");
+        m_map_size = sb.st_size;
+        if ( m_map_size < sizeof( Header))
+            throw new _Exception( EINVAL, "not a binary manifest");
+        m_map = (const u8*)mmap( nullptr, m_map_size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if ( m_map == MAP_FAILED) {
+            m_map = nullptr;
+            throw new _Exception( errno, "binary manifest");
+        }
+        const Header &h = *(const Header*)m_map;
+        if ( memcmp( h.magic, cMagic, sizeof( cMagic)) != 0 || h.record_size != sizeof( Record) || h.check != headerCheck( h)
+            || h.count > m_map_size / sizeof( Record) || !within( sizeof( Header), h.count * sizeof( Record))
+            || !within( h.strings, h.strings_size) || (h.strings_size > 0 && m_map[h.strings + h.strings_size - 1] != 0)
+            || !within( h.path_index, h.count * sizeof( PathKey)) || !within( h.digest_index, h.count * sizeof( u64))
+            || h.path_index % 8 != 0 || h.digest_index % 8 != 0)
+            throw new _Exception( EINVAL, "not a binary manifest");
+        m_header  = &h;
+        m_records = (const Record*)(m_map + sizeof( Header));
+        m_strings = (const char*)(m_map + h.strings);
+        m_paths   = (const PathKey*)(m_map + h.path_index);
+        m_digests = (const u64*)(m_map + h.digest_index);
+    }
+    ~BinaryManifest() {
+        if ( m_map != nullptr)
+            munmap( (void*)m_map, m_map_size);
+        if ( m_fd >= 0)
+            ::close( m_fd);
+    }
+
+    u64 count()                                         const noexcept { return m_header->count; }
+    const Record& record(const u64 i)                   const noexcept { return m_records[i]; }
+    /* description:    the string at p_offset of the table, "" if outside                                          */
+    const char* string(const u64 p_offset)              const noexcept {
+        return p_offset < m_header->strings_size ? m_strings + p_offset : "";
+    }
+
+    /* description:    the record of p_dir / p_name, the first one written if more
+       return value:   nullptr, if there is none                                                                   */
+    const Record* find(const char* p_dir, const char* p_name) const noexcept {
+        const u64 hash = pathHash( p_dir, p_name);
+        u64 low = 0, high = count();
+        while (low < high) {
+            const u64 mid = low + (high - low) / 2;
+            if ( m_paths[mid].hash < hash)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        for (; low < count() && m_paths[low].hash == hash; low++) {
+            if ( m_paths[low].record >= count())
+                continue;
+            const Record &r = m_records[m_paths[low].record];
+            if ( strcmp( string( r.dir), p_dir) == 0 && strcmp( string( r.name), p_name) == 0)
+                return &r;
+        }
+        return nullptr;
+    }
+
+    /* description:    the records with the digest p_digest are byDigest( p_first) .. byDigest( p_first + count - 1)
+       return value:   their count                                                                                 */
+    u64 findDigest(const u8* p_digest, u64 &p_first) const noexcept {
+        auto less = [&]( const u64 i, const bool p_upper) {
+            const int c = memcmp( m_records[m_digests[i] < count() ? m_digests[i] : 0].digest, p_digest, 32);
+            return p_upper ? c <= 0 : c < 0;
+        };
+        u64 bounds[2];
+        for (int upper = 0; upper < 2; upper++) {
+            u64 low = 0, high = count();
+            while (low < high) {
+                const u64 mid = low + (high - low) / 2;
+                if ( less( mid, upper))
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            bounds[upper] = low;
+        }
+        p_first = bounds[0];
+        return bounds[1] - bounds[0];
+    }
+    const Record& byDigest(const u64 i)                 const noexcept { return m_records[m_digests[i] < count() ? m_digests[i] : 0]; }
+
+    /* description:    the record as a line of the text output, TYPE|mode|size|hash|dir/|name, into p_line
+       return value:   p_line                                                                                      */
+    char* format(const Record &p_r, char* p_line, const size_t p_size) const noexcept {
+        char mode[8] = "    ";
+        char size[16];
+        char hash[65];
+        if ( p_r.mode >= 0)
+            snprintf( mode, sizeof( mode), "%04o", p_r.mode);
+        if ( p_r.flags & cError)
+            snprintf( size, sizeof( size), "#%05llu error", (unsigned long long)p_r.size);
+        else if ( p_r.flags & cSizeUnknown)
+            snprintf( size, sizeof( size), "%12s", "");
+        else
+            snprintf( size, sizeof( size), "%12llu", (unsigned long long)p_r.size);
+        static constexpr char cHex[] = "0123456789abcdef";
+        for (u32 i = 0; i < 32; i++) {
+            hash[2 * i]     = (p_r.flags & cHashed) ? cHex[p_r.digest[i] >> 4] : ' ';
+            hash[2 * i + 1] = (p_r.flags & cHashed) ? cHex[p_r.digest[i] & 15] : ' ';
+        }
+        hash[64] = 0;
+        snprintf( p_line, p_size, "%.4s|%s|%s|%s|%s/|%s", p_r.type, mode, size, hash, string( p_r.dir), string( p_r.name));
+        return p_line;
+    }
+};
+
+/* writes a binary manifest, record by record; the indexes are sorted by close(). Not thread safe                      */
+class BinaryManifestWriter : Independent {
+    static constexpr u64 cBuffered = 1024;  // records
+
+    DStringContainer<PATH_MAX + 8> m_path;
+    DStringContainer<PATH_MAX + 8> m_tmp_path;
+    int m_fd = -1;
+    BinaryManifest::Record m_buffer[cBuffered];
+    u64 m_buffered = 0;
+    u64 m_count = 0;
+    BinaryManifest::PathKey* m_paths = nullptr;
+    u64 m_paths_capacity = 0;
+    char* m_strings = nullptr;  // each string once, found by m_slots
+    u64 m_strings_size = 0;
+    u64 m_strings_capacity = 0;
+    u64* m_slots = nullptr;     // open addressing, offset + 1 of the string, 0 if free
+    u64 m_slots_mask = 0;
+    u64 m_slots_used = 0;
+    u64 m_last_dir = 0;         // the records of a directory follow each other mostly
+    bool m_has_last_dir = false;
+
+    void flushRecords() {
+        if ( !File::writeAll( m_fd, m_buffer, m_buffered * sizeof( BinaryManifest::Record)))
+            throw new _Exception( errno, "binary manifest");
+        m_buffered = 0;
+    }
+
+    void growSlots() {
+        const u64 size = m_slots == nullptr ? 4096 : 2 * (m_slots_mask + 1);
+        u64* slots = (u64*)calloc( size, sizeof( u64));
+        if ( slots == nullptr)
+            throw new _Exception( ENOMEM, "binary manifest");
+        for (u64 i = 0; m_slots != nullptr && i <= m_slots_mask; i++)
+            if ( m_slots[i] != 0) {
+                const char* s = m_strings + m_slots[i] - 1;
+                u64 j = BinaryManifest::fnv( s, strlen( s)) & (size - 1);
+                while (slots[j] != 0)
+                    j = (j + 1) & (size - 1);
+                slots[j] = m_slots[i];
+            }
+        free( m_slots);
+        m_slots = slots;
+        m_slots_mask = size - 1;
+    }
+
+    u64 intern(const char* p_string) {
+        if ( 2 * (m_slots_used + 1) > m_slots_mask + 1)
+            growSlots();
+        const u64 len = strlen( p_string) + 1;
+        u64 i = BinaryManifest::fnv( p_string, len - 1) & m_slots_mask;
+        for (; m_slots[i] != 0; i = (i + 1) & m_slots_mask)
+            if ( strcmp( m_strings + m_slots[i] - 1, p_string) == 0)
+                return m_slots[i] - 1;
+        if ( m_strings_size + len > m_strings_capacity) {
+            m_strings_capacity = max<u64>( 2 * m_strings_capacity, m_strings_size + len + 64 * 1024);
+            char* strings = (char*)realloc( m_strings, m_strings_capacity);
+            if ( strings == nullptr)
+                throw new _Exception( ENOMEM, "binary manifest");
+            m_strings = strings;
+        }
+        const u64 offset = m_strings_size;
+        memcpy( m_strings + offset, p_string, len);
+        m_strings_size += len;
+        m_slots[i] = offset + 1;
+        m_slots_used++;
+        return offset;
+    }
+
+    static int comparePaths(const void* p_a, const void* p_b) noexcept {
+        const BinaryManifest::PathKey &a = *(const BinaryManifest::PathKey*)p_a;
+        const BinaryManifest::PathKey &b = *(const BinaryManifest::PathKey*)p_b;
+        return a.hash != b.hash ? (a.hash < b.hash ? -1 : 1) : a.record < b.record ? -1 : a.record > b.record ? 1 : 0;
+    }
+public:
+    /* description:    creates p_path.tmp, renamed to p_path by close()
+       error:          errno of creating it                                                                         */
+    explicit BinaryManifestWriter(const char* p_path) {
+        m_path << p_path;
+        m_tmp_path << p_path << ".tmp";
+        m_fd = ::open( m_tmp_path.begin(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if ( m_fd < 0)
+            throw new _Exception( errno, "binary manifest");
+        BinaryManifest::Header h;
+        memset( &h, 0, sizeof( h));  // the real header follows, when the counts are known
+        if ( !File::writeAll( m_fd, &h, sizeof( h)))
+            throw new _Exception( errno, "binary manifest");
+    }
+    ~BinaryManifestWriter() {
+        if ( m_fd >= 0) {  // not closed
+            ::close( m_fd);
+            unlink( m_tmp_path.begin());
+        }
+        free( m_paths);
+        free( m_strings);
+        free( m_slots);
+    }
+
+    /* description:    appends a record; p_digest is taken if p_flags has cHashed, p_size is the errno with cError
+       error:          ENOMEM, errno of writing                                                                    */
+    void add(const char* p_type, const i32 p_mode, const u64 p_size, const u16 p_flags, const u8* p_digest,
+             const char* p_dir, const char* p_name) {
+        BinaryManifest::Record &r = m_buffer[m_buffered++];
+        memset( &r, 0, sizeof( r));
+        if ( p_flags & BinaryManifest::cHashed)
+            memcpy( r.digest, p_digest, 32);
+        r.size  = p_size;
+        if ( !m_has_last_dir || strcmp( m_strings + m_last_dir, p_dir) != 0)
+            m_last_dir = intern( p_dir);
+        m_has_last_dir = true;
+        r.dir   = m_last_dir;
+        r.name  = intern( p_name);
+        memcpy( r.type, p_type, 4);
+        r.mode  = (i16)p_mode;
+        r.flags = p_flags;
+        if ( m_count == m_paths_capacity) {
+            m_paths_capacity = m_paths_capacity == 0 ? 4096 : 2 * m_paths_capacity;
+            BinaryManifest::PathKey* paths = (BinaryManifest::PathKey*)realloc( m_paths, m_paths_capacity * sizeof( BinaryManifest::PathKey));
+            if ( paths == nullptr)
+                throw new _Exception( ENOMEM, "binary manifest");
+            m_paths = paths;
+        }
+        m_paths[m_count] = BinaryManifest::PathKey{ BinaryManifest::pathHash( p_dir, p_name), m_count };
+        m_count++;
+        if ( m_buffered == cBuffered)
+            flushRecords();
+    }
+
+    /* description:    writes the string table and the indexes, syncs the file, unless p_sync is false, as for a
+                       temporary one, and renames it to its path
+       error:          errno of writing, mapping or renaming                                                       */
+    void close(const bool p_sync = true) {
+        flushRecords();
+        BinaryManifest::Header h;
+        memset( &h, 0, sizeof( h));
+        memcpy( h.magic, BinaryManifest::cMagic, sizeof( h.magic));
+        h.record_size  = sizeof( BinaryManifest::Record);
+        h.count        = m_count;
+        h.strings      = sizeof( h) + m_count * sizeof( BinaryManifest::Record);
+        h.strings_size = m_strings_size;
+        h.path_index   = (h.strings + h.strings_size + 7) & ~(u64)7;
+        h.digest_index = h.path_index + m_count * sizeof( BinaryManifest::PathKey);
+        const u64 pad = 0;
+        bool ok = File::writeAll( m_fd, m_strings, m_strings_size) && File::writeAll( m_fd, &pad, h.path_index - h.strings - h.strings_size);
+        qsort( m_paths, m_count, sizeof( BinaryManifest::PathKey), comparePaths);
+        ok = ok && File::writeAll( m_fd, m_paths, m_count * sizeof( BinaryManifest::PathKey));
+
+        // the records are sorted by digest where they were written
+        u64* digests = (u64*)malloc( (m_count + 1) * sizeof( u64));
+        void* map = ok && digests != nullptr && m_count > 0 ? mmap( nullptr, h.strings, PROT_READ, MAP_SHARED, m_fd, 0) : nullptr;
+        if ( map == MAP_FAILED || (digests == nullptr && ok))
+            ok = false;
+        else if ( map != nullptr) {
+            for (u64 i = 0; i < m_count; i++)
+                digests[i] = i;
+            qsort_r( digests, m_count, sizeof( u64), []( const void* p_a, const void* p_b, void* p_records) {
+                const BinaryManifest::Record* records = (const BinaryManifest::Record*)p_records;
+                const u64 a = *(const u64*)p_a, b = *(const u64*)p_b;
+                const int c = memcmp( records[a].digest, records[b].digest, 32);
+                return c != 0 ? c : a < b ? -1 : a > b ? 1 : 0;
+            }, (u8*)map + sizeof( h));
+            munmap( map, h.strings);
+        }
+        ok = ok && File::writeAll( m_fd, digests, m_count * sizeof( u64));
+        free( digests);
+        h.check = BinaryManifest::headerCheck( h);
+        ok = ok && pwrite( m_fd, &h, sizeof( h), 0) == sizeof( h) && (!p_sync || fsync( m_fd) == 0);
+        const int error = errno;
+        ::close( m_fd);
+        m_fd = -1;
+        if ( !ok || rename( m_tmp_path.begin(), m_path.begin()) != 0) {
+            unlink( m_tmp_path.begin());
+            throw new _Exception( ok ? errno : error, "binary manifest");
+        }
+    }
+};
+
+#endif
+#endif /* binmanifest_hpp */
@@ -0,0 +1,331 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Persistent cache of file digests, keyed by the FileStamp (dev, inode, size, mtime, ctime). The cache file is a        *
+ *   header, a region of records sorted by (dev, inode), mapped and binary searched, and a tail of records appended by     *
+ *   later runs, indexed in memory on open. Every record carries a checksum: a record torn by a crash is cut off on the    *
+ *   next open. Compaction merges the tail into the sorted region, written to a new file renamed over the old one.         *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef hashcache_hpp
+#define hashcache_hpp
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <mutex>
+#include "base.hpp"
+#include "io.hpp"
+
+VERSION( hashcache_hpp, 0, 1, 0, 0);
+
+class HashCache : Independent {
+public:
+    static constexpr u64 cCompactRatio = 8;  // compacted, when the tail reaches 1/8 of the sorted region
+
+    struct Record {
+        u64 dev;
+        u64 ino;
+        u64 size;
+        i64 mtime;
+        i64 ctime;
+        u8  digest[32];
+        u32 reserved;
+        u32 check;  // of the bytes in front
+
+        static u32 checksum(const void* p_data, const u64 p_len) noexcept {  // FNV-1a
+            u32 h = 2166136261u;
+            for (const u8* p = (const u8*)p_data; p < (const u8*)p_data + p_len; p++)
+                h = (h ^ *p) * 16777619u;
+            return h;
+        }
+        bool valid()                        const noexcept { return check == checksum( this, offsetof( Record, check)); }
+        bool matches(const FileStamp &p_s)  const noexcept {
+            return dev == p_s.dev && ino == p_s.ino && size == p_s.size && mtime == p_s.mtime && ctime == p_s.ctime;
+        }
+        static int compare(const Record &a, const Record &b) noexcept {
+            return a.dev != b.dev ? (a.dev < b.dev ? -1 : 1) : a.ino != b.ino ? (a.ino < b.ino ? -1 : 1) : 0;
+        }
+    };
+    static_assert( sizeof( Record) == 80, "cache record layout");
+
+private:
+    static constexpr char cMagic[8] = { 'S', '2', '5', '6', 'C', 'A', 'C', '1' };
+    static constexpr u64  cAppendBuffer = 64 * 1024 / sizeof( Record);
+    struct Header {
+        char magic[8];
+        u32  record_size;
+        u32  reserved;
+        u64  sorted;  // records in the sorted region, following the header
+        u64  check;
+    };
+
+    DStringContainer<PATH_MAX> m_path;
+    int m_fd = -1;
+    u8* m_map = nullptr;
+    u64 m_map_size = 0;
+    const Record* m_sorted = nullptr;
+    u64 m_sorted_count = 0;
+    const Record* m_tail = nullptr;
+    u64 m_tail_count = 0;
+    const Record** m_tail_index = nullptr;  // open addressing by (dev, inode), the last record of a key
+    u64 m_tail_mask = 0;
+    std::mutex m_lock;                      // guards what follows
+    Record* m_added = nullptr;              // stored by this run, all of them kept for compaction
+    u64 m_added_count = 0;
+    u64 m_added_capacity = 0;
+    u64 m_added_written = 0;
+    bool m_rewrite = false;                 // the file is not a valid cache, compact it in any case
+
+    static u64 slot(const u64 p_dev, const u64 p_ino) noexcept {
+        u64 h = (p_dev * 0x9e3779b97f4a7c15ull) ^ p_ino;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        return h ^ (h >> 33);
+    }
+    static u64 headerCheck(const Header &p_h) noexcept { return Record::checksum( &p_h, offsetof( Header, check)); }
+
+    void load() {
+        struct stat sb;
+        if ( fstat( m_fd, &sb) != 0)
+            throw new _Exception( errno, "hash cache");
+        m_map_size = sb.st_size;
+        if ( m_map_size == 0) {
+            m_rewrite = true;
+            return;
+        }
+        m_map = (u8*)mmap( nullptr, m_map_size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if ( m_map == MAP_FAILED) {
+            m_map = nullptr;
+            throw new _Exception( errno, "hash cache");
+        }
+        const Header &h = *(const Header*)m_map;
+        if ( m_map_size < sizeof( cMagic) || memcmp( h.magic, cMagic, sizeof( cMagic)) != 0)
+            throw new _Exception( EINVAL, "not a hash cache");  // a foreign file is refused, not overwritten
+        if ( m_map_size < sizeof( Header) || h.record_size != sizeof( Record) || h.check != headerCheck( h)
+            || sizeof( Header) + h.sorted * sizeof( Record) > m_map_size) {
+            m_rewrite = true;  // broken, nothing is reused
+            return;
+        }
+        m_sorted = (const Record*)(m_map + sizeof( Header));
+        m_sorted_count = h.sorted;
+        m_tail = m_sorted + m_sorted_count;
+        const u64 tail_max = (m_map_size - sizeof( Header)) / sizeof( Record) - m_sorted_count;
+        while ( m_tail_count < tail_max && m_tail[m_tail_count].valid())
+            m_tail_count++;
+        // a torn append of a crash is cut off, appending goes on behind the last valid record
+        const u64 end = sizeof( Header) + (m_sorted_count + m_tail_count) * sizeof( Record);
+        if ( end != m_map_size && ftruncate( m_fd, end) != 0)
+            throw new _Exception( errno, "hash cache");
+        m_tail_mask = 1;
+        while (m_tail_mask < 2 * m_tail_count)
+            m_tail_mask *= 2;
+        m_tail_index = (const Record**)calloc( m_tail_mask, sizeof( Record*));
+        if ( m_tail_index == nullptr)
+            throw new _Exception( ENOMEM, "hash cache");
+        m_tail_mask--;
+        for (const Record* r = m_tail; r < m_tail + m_tail_count; r++) {
+            u64 i = slot( r->dev, r->ino) & m_tail_mask;
+            while (m_tail_index[i] != nullptr && Record::compare( *m_tail_index[i], *r) != 0)
+                i = (i + 1) & m_tail_mask;
+            m_tail_index[i] = r;  // later ones win
+        }
+    }
+
+    void appendAdded() {
+        const u64 count = m_added_count - m_added_written;
+        if ( count == 0 || m_rewrite)
+            return;
+        if ( !File::writeAll( m_fd, &m_added[m_added_written], count * sizeof( Record)))
+            throw new _Exception( errno, "hash cache");
+        m_added_written = m_added_count;
+    }
+
+    struct Ref {
+        const Record* record;
+        u64 seq;  // tail ahead of added, each in order of writing
+    };
+    static int compareRef(const void* a, const void* b) noexcept {
+        const Ref &ra = *(const Ref*)a;
+        const Ref &rb = *(const Ref*)b;
+        const int c = Record::compare( *ra.record, *rb.record);
+        return c != 0 ? c : ra.seq < rb.seq ? -1 : ra.seq > rb.seq ? 1 : 0;
+    }
+
+    // merges the sorted region with the tail and the added records into path.tmp, renamed over path
+    void compact() {
+        const u64 n = m_tail_count + m_added_count;
+        Ref* news = (Ref*)malloc( (n + 1) * sizeof( Ref));
+        if ( news == nullptr)
+            throw new _Exception( ENOMEM, "hash cache");
+        for (u64 i = 0; i < m_tail_count; i++)
+            news[i] = Ref{ &m_tail[i], i };
+        for (u64 i = 0; i < m_added_count; i++)
+            news[m_tail_count + i] = Ref{ &m_added[i], m_tail_count + i };
+        qsort( news, n, sizeof( Ref), compareRef);
+
+        DStringContainer<PATH_MAX + 8> tmp_path;
+        tmp_path << m_path.reader() << ".tmp";
+        const int fd = ::open( tmp_path.begin(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if ( fd < 0) {
+            free( news);
+            throw new _Exception( errno, "hash cache");
+        }
+        Record* out = (Record*)malloc( cAppendBuffer * sizeof( Record));
+        Header h;
+        memset( &h, 0, sizeof( h));
+        bool ok = out != nullptr && File::writeAll( fd, &h, sizeof( h));  // the real header follows, when the count is known
+        u64 written = 0, used = 0;
+        auto put = [&]( const Record &p_r) {
+            out[used++] = p_r;
+            written++;
+            if ( used == cAppendBuffer) {
+                ok = ok && File::writeAll( fd, out, used * sizeof( Record));
+                used = 0;
+            }
+        };
+        u64 s = 0, a = 0;
+        while (ok && (s < m_sorted_count || a < n)) {
+            if ( a + 1 < n && Record::compare( *news[a].record, *news[a + 1].record) == 0) {
+                a++;  // superseded by a later one
+                continue;
+            }
+            const int c = s == m_sorted_count ? 1 : a == n ? -1 : Record::compare( m_sorted[s], *news[a].record);
+            if ( c < 0)
+                put( m_sorted[s++]);
+            else {
+                if ( c == 0)
+                    s++;
+                put( *news[a++].record);
+            }
+        }
+        ok = ok && File::writeAll( fd, out, used * sizeof( Record));
+        memcpy( h.magic, cMagic, sizeof( cMagic));
+        h.record_size = sizeof( Record);
+        h.sorted = written;
+        h.check = headerCheck( h);
+        ok = ok && pwrite( fd, &h, sizeof( h), 0) == sizeof( h) && fsync( fd) == 0;
+        const int error = errno;
+        ::close( fd);
+        free( out);
+        free( news);
+        if ( !ok || rename( tmp_path.begin(), m_path.begin()) != 0) {
+            unlink( tmp_path.begin());
+            throw new _Exception( ok ? errno : error, "hash cache");
+        }
+    }
+public:
+    static inline bool s_rehash = false;  // lookups miss, all digests are stored anew
+
+    /* description:    opens or creates the cache file, locked against other runs
+       error:          errno of opening, EWOULDBLOCK if another run uses it                                        */
+    explicit HashCache(const char* p_path) {
+        m_path << p_path;
+        m_fd = ::open( p_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if ( m_fd < 0)
+            throw new _Exception( errno, "hash cache");
+        if ( flock( m_fd, LOCK_EX | LOCK_NB) != 0)
+            throw new _Exception( errno, "hash cache in use");
+        load();
+        lseek( m_fd, 0, SEEK_END);
+    }
+    ~HashCache() {
+        free( m_added);
+        free( m_tail_index);
+        if ( m_map != nullptr)
+            munmap( m_map, m_map_size);
+        if ( m_fd >= 0)
+            ::close( m_fd);
+    }
+
+    /* description:    the digest stored for the stamp
+       return value:   false, if there is none or it is outdated; always with s_rehash                             */
+    bool lookup(const FileStamp &p_stamp, u8 (&p_digest)[32]) const noexcept {
+        if ( s_rehash)
+            return false;
+        const Record* found = nullptr;
+        if ( m_tail_index != nullptr) {
+            for (u64 i = slot( p_stamp.dev, p_stamp.ino) & m_tail_mask; m_tail_index[i] != nullptr; i = (i + 1) & m_tail_mask)
+                if ( m_tail_index[i]->dev == p_stamp.dev && m_tail_index[i]->ino == p_stamp.ino) {
+                    found = m_tail_index[i];
+                    break;
+                }
+        }
+        for (u64 low = 0, high = m_sorted_count; found == nullptr && low < high; ) {
+            const u64 mid = low + (high - low) / 2;
+            const Record &r = m_sorted[mid];
+            if ( r.dev == p_stamp.dev && r.ino == p_stamp.ino)
+                found = &r;
+            else if ( r.dev < p_stamp.dev || (r.dev == p_stamp.dev && r.ino < p_stamp.ino))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        if ( found == nullptr || !found->matches( p_stamp) || !found->valid())
+            return false;
+        memcpy( p_digest, found->digest, 32);
+        return true;
+    }
+
+    /* description:    stores the digest of the stamp, appended to the cache file in blocks; thread safe
+       error:          errno of writing                                                                            */
+    void store(const FileStamp &p_stamp, const ArraySpan<u8> &p_digest) {
+        Record r;
+        memset( &r, 0, sizeof( r));
+        r.dev   = p_stamp.dev;
+        r.ino   = p_stamp.ino;
+        r.size  = p_stamp.size;
+        r.mtime = p_stamp.mtime;
+        r.ctime = p_stamp.ctime;
+        u8 i = 0;
+        for (const u8 b : p_digest)
+            r.digest[i++] = b;
+        r.check = Record::checksum( &r, offsetof( Record, check));
+        std::lock_guard<std::mutex> guard( m_lock);
+        if ( m_added_count == m_added_capacity) {
+            const u64 capacity = max<u64>( 2 * m_added_capacity, cAppendBuffer);
+            Record* added = (Record*)realloc( m_added, capacity * sizeof( Record));
+            if ( added == nullptr)
+                throw new _Exception( ENOMEM, "hash cache");
+            m_added = added;
+            m_added_capacity = capacity;
+        }
+        m_added[m_added_count++] = r;
+        if ( m_added_count - m_added_written >= cAppendBuffer)
+            appendAdded();
+    }
+
+    /* description:    writes what is pending and syncs it; compacts, if the tail grew large enough or the file was
+                       not a valid cache
+       error:          errno of writing                                                                            */
+    void close() {
+        std::lock_guard<std::mutex> guard( m_lock);
+        appendAdded();
+        if ( m_rewrite || (m_tail_count + m_added_count) * cCompactRatio > m_sorted_count)
+            compact();
+        else if ( fdatasync( m_fd) != 0)
+            throw new _Exception( errno, "hash cache");
+    }
+};
+
+#endif
+#endif /* hashcache_hpp */
@@ -20,14 +20,31 @@
 #define io_hpp
 
 #include <stdio.h>
+#include <atomic>
 #include "base.hpp"
 #include "sha256.hpp"
+#include "stats.hpp"
+#include "throttle.hpp"
 
 VERSION( io_hpp, 0, 2, 0, 3);
 
 #ifndef _WIN32 // UNIX/LINUX
     #include <sys/socket.h>
     #include <netinet/in.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <stdlib.h>
+    #include <signal.h>
+    #include <setjmp.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <dirent.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+        #include <sys/ioctl.h>
+        #include <linux/fs.h>
+        #include <linux/fiemap.h>
+    #endif
     #define GetLastNetworkError errno
     #define __MSG_TO_WAIT MSG_WAITALL
     #define SOCKET int
@@ -37,7 +54,10 @@ VERSION( io_hpp, 0, 2, 0, 3);
     #define GetLastNetworkError WSAGetLastError()
     #define __MSG_TO_WAIT 0
     #define SHUT_RDWR 2
+    #define AT_FDCWD -100
     typedef u64 off_t;
+    #include <io.h>
+    #include <malloc.h>
 #endif
 
 
@@ -177,6 +197,42 @@ public:
             throw new _Exception( errno, file_name);
         return errno;
     }
+#ifndef _WIN32
+    /* description:    opens p_name relative to the open directory p_dir_fd for reading, as openat(2)
+       return value:   0 or the error, never thrown                                                                */
+    int openAt(const int p_dir_fd, const char* p_name) noexcept {
+        close();
+        f = nullptr;
+        if ( file_ptr_is_foreign)
+            return EBADF;
+        const u64 start = Stats::start();
+        const int fd = ::openat( p_dir_fd, p_name, O_RDONLY | O_CLOEXEC);
+        Stats::stop( Stats::cOpen, start, 0, p_name);
+        if ( fd < 0)
+            return errno;
+        Throttle::open();
+        if ( (f = fdopen( fd, "r")) == nullptr) {
+            const int err = errno;
+            ::close( fd);
+            return err;
+        }
+        return 0;
+    }
+
+    /* description:    writes p_len bytes to the descriptor p_fd, write(2) repeated on short writes and EINTR
+       return value:   false on an error, in errno                                                                 */
+    static bool writeAll(const int p_fd, const void* p_data, const u64 p_len) noexcept {
+        for (u64 done = 0; done < p_len; ) {
+            const auto written = ::write( p_fd, (const u8*)p_data + done, p_len - done);
+            if ( written < 0 && errno == EINTR)
+                continue;
+            if ( written <= 0)
+                return false;
+            done += written;
+        }
+        return true;
+    }
+#endif
     void close() {
         if ( !file_ptr_is_foreign && f)
             fclose(f);
@@ -187,6 +243,12 @@ public:
     }
     inline bool is_open()                               const noexcept { return f != nullptr; }
     inline auto getc()                                  const noexcept { return ::fgetc(f); }
+    inline u64  read(void* p, const u64 count)          const noexcept { return ::fread(p, 1, count, f); }
+#ifndef _WIN32
+    inline int  descriptor()                            const noexcept { return ::fileno(f); }
+#else
+    inline int  descriptor()                            const noexcept { return ::_fileno(f); }
+#endif
     inline auto eof()                                   const noexcept { return ::feof(f); }
     inline auto tell()                                  const noexcept { return ::ftell(f); }
     inline u64  seek(off_t offset, int whence)          const noexcept { return ::fseek(f, offset, whence); }
@@ -231,13 +293,539 @@ public:
     }
 };
 
-Sha256& operator << (Sha256& dest, const File &f) {
-    DArrayContainer<u8, 64> m_ar;
-    PipeEndFileRx<u8> file(f);
-    do {
-        file.readFromPipe( m_ar);
-        dest.add_block(m_ar.reader());
-    } while (m_ar.past_count() > 0);
+#ifndef _WIN32
+/* identity and version of a file as far as stat tells: an unchanged stamp means unchanged content                   */
+struct FileStamp {
+    u64 dev   = 0;
+    u64 ino   = 0;
+    u64 size  = 0;
+    i64 mtime = 0;  // ns
+    i64 ctime = 0;  // ns
+    u32 nlink = 0;  // links to the inode, not part of the identity
+
+    static FileStamp of(const struct stat &p_sb) noexcept {
+        FileStamp stamp;
+        stamp.dev   = p_sb.st_dev;
+        stamp.ino   = p_sb.st_ino;
+        stamp.size  = p_sb.st_size;
+        stamp.nlink = p_sb.st_nlink;
+    #ifdef __APPLE__
+        stamp.mtime = (i64)p_sb.st_mtimespec.tv_sec * 1000000000 + p_sb.st_mtimespec.tv_nsec;
+        stamp.ctime = (i64)p_sb.st_ctimespec.tv_sec * 1000000000 + p_sb.st_ctimespec.tv_nsec;
+    #else
+        stamp.mtime = (i64)p_sb.st_mtim.tv_sec * 1000000000 + p_sb.st_mtim.tv_nsec;
+        stamp.ctime = (i64)p_sb.st_ctim.tv_sec * 1000000000 + p_sb.st_ctim.tv_nsec;
+    #endif
+        return stamp;
+    }
+    bool valid() const noexcept { return dev != 0 || ino != 0; }
+};
+#endif
+
+/* Streaming input of whole files: raw read(2) on the descriptor in large, page aligned chunks, the kernel advised to
+   read ahead sequentially. One call per chunk instead of one fread per 64 bytes.                                    */
+class FileReader : Independent {
+public:
+    static constexpr u64 cAlignment         = 4096;
+    static constexpr u64 cBufferSizeMin     = 256 * 1024;
+    static constexpr u64 cBufferSizeMax     = 4 * 1024 * 1024;
+    static constexpr u64 cBufferSizeDefault = 1024 * 1024;
+private:
+    static inline u64 s_buffer_size = cBufferSizeDefault;
+    static inline bool s_nocache = false;
+    u8* m_buffer = nullptr;
+    u64 m_size = 0;
+    u8* m_resident = nullptr;  // --nocache: page cache residency, see residentPages()
+
+#ifndef _WIN32
+    static u64 pageSize() noexcept {
+        static const u64 size = sysconf( _SC_PAGESIZE) > 0 ? sysconf( _SC_PAGESIZE) : cAlignment;
+        return size;
+    }
+    static bool setDirect(const int p_fd, const bool p_direct) noexcept {
+    #ifdef O_DIRECT
+        const int flags = fcntl( p_fd, F_GETFL);
+        return flags != -1 && fcntl( p_fd, F_SETFL, p_direct ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+    #else
+        return false;
+    #endif
+    }
+    // page cache residency is noted window by window, a window ahead of reading: the read ahead of the kernel can not
+    // blur it then. A window is dropped when it is read completely, large folios of the page cache straddle chunks
+    static constexpr u64 cResidentWindow = 64 * 1024 * 1024;
+    u8* residentWindow(const u64 p_window) noexcept { return m_resident + (p_window & 1) * residentSize( cResidentWindow); }
+
+    // O_DIRECT from the aligned buffer, the unaligned tail comes as a short read. Falls back to buffered reading and
+    // dropPages() where O_DIRECT is refused, by fcntl or by a read (EINVAL)
+    template <typename SINK>
+    u64 streamNoCache(const int p_fd, SINK &&p_sink) {
+        const off_t position = lseek( p_fd, 0, SEEK_CUR);
+        u64 offset = position < 0 ? 0 : position;
+        bool direct = position >= 0 && offset % cAlignment == 0 && setDirect( p_fd, true);
+        bool known[2] = { false, false };
+        u64 next_window = offset / cResidentWindow;  // the first window without noted residency
+        u64 drop_window = next_window;               // the first window not dropped yet
+        auto drop = [&]( const u64 p_end) {
+            for (; drop_window < p_end; drop_window++)
+                if ( known[drop_window & 1])
+                    dropPages( p_fd, drop_window * cResidentWindow, cResidentWindow, residentWindow( drop_window));
+        };
+        u64 total = 0;
+        for (;;) {
+            for (; !direct && next_window <= offset / cResidentWindow + 1; next_window++)
+                known[next_window & 1] = residentPages( p_fd, next_window * cResidentWindow, cResidentWindow, residentWindow( next_window));
+            const u64 start = Stats::start();
+            const auto readen = ::read( p_fd, m_buffer, m_size);
+            Stats::stop( Stats::cRead, start, readen > 0 ? readen : 0);
+            Throttle::read( readen > 0 ? readen : 0);
+            if (readen < 0 && errno == EINTR)
+                continue;
+            if (readen < 0 && errno == EINVAL && direct) {  // not supported here, or unaligned after a file grew
+                direct = !setDirect( p_fd, false);
+                next_window = drop_window = offset / cResidentWindow;
+                if ( !direct)
+                    continue;
+            }
+            if (readen <= 0)
+                break;
+            p_sink( m_buffer, (u64)readen);
+            offset += readen;
+            total += readen;
+            if ( !direct)
+                drop( offset / cResidentWindow);
+        }
+        if ( !direct)
+            drop( offset / cResidentWindow + 1);
+        if ( direct)
+            setDirect( p_fd, false);
+        return total;
+    }
+#endif
+public:
+    /* description:    a buffer of p_size bytes aligned to cAlignment, as used by readers
+       error:          ENOMEM                                                                                      */
+    static u8* allocateBuffer(const u64 p_size) {
+        u8* buffer = nullptr;
+#ifndef _WIN32
+        if ( posix_memalign( (void**)&buffer, cAlignment, p_size) != 0)
+            buffer = nullptr;
+#else
+        buffer = (u8*)_aligned_malloc( p_size, cAlignment);
+#endif
+        if ( buffer == nullptr)
+            throw new _Exception( ENOMEM, "read buffer");
+        return buffer;
+    }
+    static void freeBuffer(u8* p_buffer) noexcept {
+#ifndef _WIN32
+        free( p_buffer);
+#else
+        _aligned_free( p_buffer);
+#endif
+    }
+
+    explicit FileReader(const u64 p_size = s_buffer_size) {
+        m_size = p_size;
+        m_buffer = allocateBuffer( m_size);
+#ifndef _WIN32
+        m_resident = (u8*)malloc( 2 * residentSize( cResidentWindow));
+        if ( m_resident == nullptr)
+            throw new _Exception( ENOMEM, "read buffer");
+#endif
+    }
+    ~FileReader() {
+#ifndef _WIN32
+        free( m_resident);
+#endif
+        freeBuffer( m_buffer);
+    }
+
+    /* description:    sets the buffer size of readers created from now on, limited to cBufferSizeMin..cBufferSizeMax
+       return value:   the size in effect, rounded up to cAlignment                                                 */
+    static u64 setBufferSize(const u64 p_size) noexcept {
+        const u64 size = max( cBufferSizeMin, min( cBufferSizeMax, p_size));
+        s_buffer_size = (size + cAlignment - 1) / cAlignment * cAlignment;
+        return s_buffer_size;
+    }
+    static u64 bufferSize() noexcept { return s_buffer_size; }
+
+    /* description:    swaps the buffer for another one of the same size and alignment, e.g. from within the sink, which
+                       keeps the data read then. The buffer is from allocateBuffer( size())
+       return value:   the buffer replaced                                                                          */
+    u8* exchangeBuffer(u8* p_buffer) noexcept {
+        u8* const buffer = m_buffer;
+        m_buffer = p_buffer;
+        return buffer;
+    }
+    u64 size() const noexcept { return m_size; }
+
+    /* description:    cache neutral reading: O_DIRECT, or where the file system refuses it, the pages read are dropped
+                       from the page cache again, except those that were resident before. Nothing is read ahead then */
+    static void setNoCache(const bool p_nocache) noexcept { s_nocache = p_nocache; }
+    static bool noCache()                        noexcept { return s_nocache; }
+
+#ifndef _WIN32
+    /* description:    size of the vector for residentPages() of p_len bytes                                        */
+    static u64 residentSize(const u64 p_len) noexcept { return p_len / pageSize() + 2; }
+
+    /* description:    notes in p_resident, which pages of the range are in the page cache, ahead of reading it
+       return value:   false, if that is unknown; dropPages() must not be called then                              */
+    static bool residentPages(const int p_fd, const u64 p_offset, const u64 p_len, u8* p_resident) noexcept {
+        const u64 start = p_offset / pageSize() * pageSize();
+        const u64 len = p_offset + p_len - start;
+        void* const map = mmap( nullptr, len, PROT_READ, MAP_SHARED, p_fd, start);  // maps, does not read
+        if ( map == MAP_FAILED)
+            return false;
+        const bool known = mincore( map, len, p_resident) == 0;
+        munmap( map, len);
+        return known;
+    }
+
+    /* description:    drops the pages of the range from the page cache, that were not resident by p_resident; its
+                       first entry is for the page of p_offset                                                      */
+    static void dropPages(const int p_fd, const u64 p_offset, const u64 p_len, const u8* p_resident) noexcept {
+    #ifdef POSIX_FADV_DONTNEED
+        const u64 start = p_offset / pageSize() * pageSize();
+        const u64 pages = (p_offset + p_len - start + pageSize() - 1) / pageSize();
+        for (u64 page = 0; page < pages; ) {
+            u64 end = page;
+            while ( end < pages && (p_resident[end] & 1) == 0)
+                end++;
+            if ( end > page)
+                posix_fadvise( p_fd, start + page * pageSize(), (end - page) * pageSize(), POSIX_FADV_DONTNEED);
+            page = end + 1;
+        }
+    #endif
+    }
+#endif
+
+    /* description:    hint: the file will be read soon, the kernel may start reading ahead its first buffer
+       return value:   none, hints never fail                                                                       */
+    static void prefetch(const char* p_path) noexcept {
+#ifndef _WIN32
+        prefetch( AT_FDCWD, p_path);
+#endif
+    }
+#ifndef _WIN32
+    static void prefetch(const int p_dir_fd, const char* p_name) noexcept {
+        if ( s_nocache)
+            return;
+        const int fd = ::openat( p_dir_fd, p_name, O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0)
+            return;
+    #ifdef POSIX_FADV_WILLNEED
+        posix_fadvise( fd, 0, s_buffer_size, POSIX_FADV_WILLNEED);
+    #endif
+        ::close( fd);
+    }
+#endif
+
+#ifdef SEEK_DATA
+    /* description:    a file of fewer blocks than its size has holes, probably
+       return value:   true, if it is worth to ask for its extents                                                 */
+    static bool sparse(const struct stat &p_sb) noexcept {
+        return S_ISREG( p_sb.st_mode) && (u64)p_sb.st_blocks * 512 < (u64)p_sb.st_size && !s_nocache;
+    }
+
+    /* description:    reads the first p_size bytes of the descriptor by its extents, as SEEK_DATA and SEEK_HOLE tell:
+                       the data into p_sink( const u8*, u64), the lengths of the holes to p_holes( u64), not read
+       return value:   false, if the extents could not be told; if p_sink got data already, it is to be dropped    */
+    template <typename SINK, typename HOLES>
+    bool streamSparse(const int p_fd, const u64 p_size, SINK &&p_sink, HOLES &&p_holes) {
+        for (u64 offset = 0; offset < p_size; ) {
+            off_t data = lseek( p_fd, offset, SEEK_DATA);
+            if ( data < 0 && errno != ENXIO)
+                return false;
+            const u64 data_start = data < 0 ? p_size : min<u64>( data, p_size);  // ENXIO: a hole till the end
+            if ( data_start > offset)
+                p_holes( data_start - offset);
+            if ( data_start == p_size)
+                break;
+            const off_t hole = lseek( p_fd, data_start, SEEK_HOLE);
+            if ( hole < 0 || lseek( p_fd, data_start, SEEK_SET) < 0)
+                return false;
+            const u64 data_end = min<u64>( max<u64>( hole, data_start + 1), p_size);
+            for (u64 left = data_end - data_start; left > 0; ) {
+                const u64 start = Stats::start();
+                const auto readen = ::read( p_fd, m_buffer, min<u64>( left, m_size));
+                Stats::stop( Stats::cRead, start, readen > 0 ? readen : 0);
+                Throttle::read( readen > 0 ? readen : 0);
+                if ( readen < 0 && errno == EINTR)
+                    continue;
+                if ( readen <= 0)
+                    return false;
+                p_sink( m_buffer, (u64)readen);
+                left -= readen;
+            }
+            offset = data_end;
+        }
+        return lseek( p_fd, p_size, SEEK_SET) >= 0;
+    }
+#endif
+
+    /* description:    reads the descriptor from its current position till the end into p_sink( const u8*, u64)
+       return value:   count of bytes read; errno is set, if reading stopped on an error                           */
+    template <typename SINK>
+    u64 stream(const int p_fd, SINK &&p_sink) {
+#ifndef _WIN32
+        if ( s_nocache)
+            return streamNoCache( p_fd, p_sink);
+    #ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise( p_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+#endif
+        u64 total = 0;
+        for (;;) {
+            const u64 start = Stats::start();
+            const auto readen = ::read( p_fd, m_buffer, m_size);
+            Stats::stop( Stats::cRead, start, readen > 0 ? readen : 0);
+            Throttle::read( readen > 0 ? readen : 0);
+            if (readen < 0 && errno == EINTR)
+                continue;
+            if (readen <= 0)
+                break;
+            p_sink( m_buffer, (u64)readen);
+            total += readen;
+        }
+        return total;
+    }
+};
+
+#ifndef _WIN32
+/* Input of large regular files through mmap(2), window by window, handed to the sink without a copy into user space.
+   A file shrinking while it is mapped raises SIGBUS on access; it is caught and the caller falls back to reading.    */
+class MappedFileReader : Static {
+    static constexpr u64 cWindowSize = 16 * 1024 * 1024;
+    static inline u64 s_threshold = 0;
+    static inline thread_local sigjmp_buf* t_bus_jump = nullptr;
+
+    static void onSigBus(int p_signal, siginfo_t*, void*) {
+        if ( t_bus_jump != nullptr)
+            siglongjmp( *t_bus_jump, 1);
+        signal( p_signal, SIG_DFL);  // not ours, crash as usual
+        raise( p_signal);
+    }
+    static void installSigBusHandler() noexcept {
+        static const bool installed = []() {
+            struct sigaction sa;
+            memClean( sa);
+            sa.sa_sigaction = onSigBus;
+            sa.sa_flags = SA_SIGINFO;
+            sigemptyset( &sa.sa_mask);
+            return sigaction( SIGBUS, &sa, nullptr) == 0;
+        }();
+        (void)installed;
+    }
+public:
+    /* description:    files of at least p_size bytes are mapped, 0 maps none                                       */
+    static void setThreshold(const u64 p_size) noexcept { s_threshold = p_size; }
+    static bool wanted(const u64 p_size)       noexcept { return s_threshold > 0 && p_size >= s_threshold; }
+
+    /* description:    maps the first p_size bytes of the descriptor into p_sink( const u8*, u64)
+       return value:   false, if mapping failed or the file shrank meanwhile; p_sink may have got a part then      */
+    template <typename SINK>
+    static bool stream(const int p_fd, const u64 p_size, SINK &&p_sink) {
+        installSigBusHandler();
+        for (u64 offset = 0; offset < p_size; offset += cWindowSize) {
+            const u64 len = min( cWindowSize, p_size - offset);
+            int flags = MAP_SHARED;
+    #ifdef MAP_POPULATE
+            flags |= MAP_POPULATE;
+    #endif
+            const u64 start = Stats::start();  // populated: read by the mapping
+            u8* const window = (u8*)mmap( nullptr, len, PROT_READ, flags, p_fd, offset);
+            Stats::stop( Stats::cRead, start, window != MAP_FAILED ? len : 0);
+            Throttle::read( window != MAP_FAILED ? len : 0);
+            if ( window == MAP_FAILED)
+                return false;
+            madvise( window, len, MADV_SEQUENTIAL);
+    #ifdef POSIX_FADV_WILLNEED
+            if ( offset + len < p_size)  // the next window is read ahead while this one is hashed
+                posix_fadvise( p_fd, offset + len, cWindowSize, POSIX_FADV_WILLNEED);
+    #endif
+            sigjmp_buf bus_jump;
+            const bool shrunk = sigsetjmp( bus_jump, 1) != 0;
+            if ( !shrunk) {
+                t_bus_jump = &bus_jump;
+                p_sink( window, len);
+            }
+            t_bus_jump = nullptr;
+            munmap( window, len);
+            if ( shrunk)
+                return false;
+        }
+        return true;
+    }
+};
+
+/* The entries of an open directory, read in batches of cBatchSize by getdents64(2) on Linux, by readdir(3) elsewhere.
+   "." and ".." are skipped; the name of an entry is valid till the next call. The descriptor stays the caller's.     */
+class DirectoryReader : Independent {
+public:
+    static constexpr u64 cBatchSize = 32 * 1024;
+    struct Entry {
+        const char* name;
+        u8 type;  // DT_*, DT_UNKNOWN if the file system does not tell
+        u64 ino;
+    };
+private:
+#ifdef __linux__
+    const int m_fd;
+    char* m_batch;
+    long m_len = 0;
+    long m_pos = 0;
+#else
+    DIR* m_dir;
+#endif
+public:
+#ifdef __linux__
+    explicit DirectoryReader(const int p_fd) noexcept : m_fd( p_fd), m_batch( (char*)malloc( cBatchSize)) { }
+    ~DirectoryReader() { free( m_batch); }
+#else
+    explicit DirectoryReader(const int p_fd) noexcept : m_dir( nullptr) {
+        const int fd = dup( p_fd);
+        if ( fd >= 0 && (m_dir = fdopendir( fd)) == nullptr)
+            ::close( fd);
+    }
+    ~DirectoryReader() {
+        if ( m_dir)
+            closedir( m_dir);
+    }
+#endif
+
+    /* description:    the next entry into p_entry
+       return value:   false at the end or on an error of reading                                                  */
+    bool next(Entry &p_entry) noexcept {
+#ifdef __linux__
+        while (m_batch) {
+            if ( m_pos >= m_len) {
+                m_pos = 0;
+                const u64 start = Stats::start();
+                while ((m_len = syscall( SYS_getdents64, m_fd, m_batch, cBatchSize)) < 0 && errno == EINTR) ;
+                Stats::stop( Stats::cReadDir, start);
+                if ( m_len <= 0)
+                    return false;
+            }
+            // struct linux_dirent64: u64 d_ino, s64 d_off, u16 d_reclen, u8 d_type, char d_name[]
+            const char* record = m_batch + m_pos;
+            u16 reclen;
+            memcpy( &reclen, record + 16, sizeof( reclen));
+            memcpy( &p_entry.ino, record, sizeof( p_entry.ino));
+            m_pos += reclen;
+            p_entry.type = (u8)record[18];
+            p_entry.name = record + 19;
+            if ( !isDot( p_entry.name))
+                return true;
+        }
+        return false;
+#else
+        while (m_dir) {
+            const u64 start = Stats::start();
+            const struct dirent* ep = readdir( m_dir);
+            Stats::stop( Stats::cReadDir, start);
+            if ( ep == nullptr)
+                return false;
+            p_entry.type = ep->d_type;
+            p_entry.name = ep->d_name;
+            p_entry.ino  = ep->d_ino;
+            if ( !isDot( p_entry.name))
+                return true;
+        }
+        return false;
+#endif
+    }
+private:
+    static bool isDot(const char* p_name) noexcept {
+        return p_name[0] == '.' && (p_name[1] == 0 || (p_name[1] == '.' && p_name[2] == 0));
+    }
+};
+
+/* Order of reading for rotational disks: files sorted by the inode number, as of the directory entry, or by the
+   physical address of their first extent by FIEMAP(2). Where FIEMAP is not supported, by the inode number again.   */
+class FileOrder : Static {
+public:
+    enum Mode { cReadDir, cInode, cExtent };
+private:
+    static inline std::atomic<Mode> s_mode { cReadDir };
+public:
+    static void setMode(const Mode p_mode)   noexcept { s_mode = p_mode; }
+    static Mode mode()                       noexcept { return s_mode; }
+    static bool enabled()                    noexcept { return s_mode != cReadDir; }
+
+    /* description:    the key of the file p_name in the directory p_dir_fd, of inode p_ino
+       return value:   the physical byte address of its first extent, 0 for files without any or on errors;
+                       p_ino by inode                                                                              */
+    static u64 key(const int p_dir_fd, const char* p_name, const u64 p_ino) noexcept {
+#ifdef FS_IOC_FIEMAP
+        if ( s_mode != cExtent)
+            return p_ino;
+        const int fd = ::openat( p_dir_fd, p_name, O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+        if ( fd < 0)
+            return 0;
+        union {
+            struct fiemap map;
+            u8 space[sizeof( struct fiemap) + sizeof( struct fiemap_extent)];
+        } request;
+        memClean( request);
+        request.map.fm_length = FIEMAP_MAX_OFFSET;
+        request.map.fm_extent_count = 1;
+        const int result = ioctl( fd, FS_IOC_FIEMAP, &request.map);
+        const int error = errno;
+        ::close( fd);
+        if ( result == 0)
+            return request.map.fm_mapped_extents > 0 ? request.map.fm_extents[0].fe_physical : 0;
+        if ( error != EOPNOTSUPP && error != ENOTTY)
+            return 0;
+        s_mode = cInode;  // not by the file system: the same for the files of a directory
+        return p_ino;
+#else
+        return p_ino;
+#endif
+    }
+};
+#endif
+
+/* description:    hashes the file from its current position till the end, by a HASHER of the interface of Sha256:
+                   reset(), update(), updateZeros(), payloadLen() and hash(). A fresh dest takes sparse files by
+                   their extents, the holes hashed as zeros without reading them, and large regular files through
+                   MappedFileReader; if that fails, dest is reset and the file is read again from the start
+   return value:   dest                                                                                            */
+template <typename HASHER, typename = decltype( HASHER::cName)>
+HASHER& operator << (HASHER& dest, const File &f) {
+    static thread_local FileReader reader;
+    auto sink = [&dest]( const u8* p_data, const u64 p_len) {
+        const u64 start = Stats::start();
+        dest.update( p_data, p_len);
+        Stats::stop( Stats::cHash, start, p_len);
+    };
+#ifndef _WIN32
+    struct stat sb;
+    const bool stated = dest.payloadLen() == 0 && fstat( f.descriptor(), &sb) == 0;
+    #ifdef SEEK_DATA
+    if ( stated && FileReader::sparse( sb)) {
+        auto holes = [&dest]( const u64 p_len) {
+            const u64 start = Stats::start();
+            dest.updateZeros( p_len);
+            Stats::stop( Stats::cHash, start, p_len);
+        };
+        if ( !reader.streamSparse( f.descriptor(), sb.st_size, sink, holes)) {
+            dest.reset();
+            lseek( f.descriptor(), 0, SEEK_SET);
+        }  // else what was appended meanwhile is read below
+    }
+    else
+    #endif
+    if ( stated && S_ISREG( sb.st_mode) && MappedFileReader::wanted( sb.st_size)
+        && !FileReader::noCache()) {  // mapped pages stay in the page cache
+        if ( MappedFileReader::stream( f.descriptor(), sb.st_size, sink))
+            lseek( f.descriptor(), sb.st_size, SEEK_SET);  // what was appended meanwhile is read below
+        else {
+            dest.reset();
+            lseek( f.descriptor(), 0, SEEK_SET);
+        }
+    }
+#endif
+    reader.stream( f.descriptor(), sink);
     return dest;
 }
 
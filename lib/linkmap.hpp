@@ -0,0 +1,129 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Digests of files with more than one hard link, by (dev, inode), for this run only: a later link of an unchanged        *
+ *   inode takes the digest of the first one instead of being read again. The memory is fixed on construction: a table of   *
+ *   sets of cWays entries, thread safe by a lock per stripe of sets. An entry is dropped, when all the links of its inode  *
+ *   were seen; in a full set, the entry used least recently makes room.                                                    *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ***************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef linkmap_hpp
+#define linkmap_hpp
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include "base.hpp"
+#include "io.hpp"
+
+VERSION( linkmap_hpp, 0, 1, 0, 0);
+
+class LinkMap : Independent {
+public:
+    static constexpr u32 cWays          = 8;
+    static constexpr u32 cLocks         = 64;
+    static constexpr u64 cMemoryDefault = 16 * 1024 * 1024;
+
+    struct Entry {
+        FileStamp stamp;          // invalid, if the entry is free
+        u8        digest[32];
+        u32       remaining;      // links still to be seen
+        u32       used;           // tick of the last use
+    };
+
+private:
+    Entry*             m_entries = nullptr;
+    u64                m_set_mask = 0;
+    std::mutex         m_locks[cLocks];
+    std::atomic<u32>   m_tick { 0 };
+
+    static bool same(const FileStamp &a, const FileStamp &b) noexcept {
+        return a.dev == b.dev && a.ino == b.ino && a.size == b.size && a.mtime == b.mtime && a.ctime == b.ctime;
+    }
+    Entry* set(const FileStamp &p_stamp) const noexcept {
+        u64 h = (p_stamp.ino ^ (p_stamp.dev << 32) ^ (p_stamp.dev >> 32)) * 0x9e3779b97f4a7c15ull;
+        return &m_entries[((h >> 24) & m_set_mask) * cWays];
+    }
+    std::mutex& lock(const Entry* p_set) noexcept { return m_locks[((p_set - m_entries) / cWays) % cLocks]; }
+
+public:
+    /* description:    a table of p_memory bytes at most, cWays entries at least
+       error:          ENOMEM                                                                                      */
+    explicit LinkMap(const u64 p_memory = cMemoryDefault) {
+        u64 sets = 1;
+        while ( sets * 2 * cWays * sizeof( Entry) <= p_memory)
+            sets *= 2;
+        m_entries = (Entry*)calloc( sets * cWays, sizeof( Entry));
+        if ( m_entries == nullptr)
+            throw new _Exception( ENOMEM, "link map");
+        m_set_mask = sets - 1;
+    }
+    ~LinkMap() { free( m_entries); }
+
+    /* description:    the digest of another link of the inode of p_stamp, unchanged since; counts the link as seen
+       return value:   false, if there is none                                                                     */
+    bool lookup(const FileStamp &p_stamp, u8 (&p_digest)[32]) noexcept {
+        Entry* entries = set( p_stamp);
+        std::lock_guard<std::mutex> guard( lock( entries));
+        for (u32 i = 0; i < cWays; i++) {
+            Entry &e = entries[i];
+            if ( !e.stamp.valid() || e.stamp.dev != p_stamp.dev || e.stamp.ino != p_stamp.ino)
+                continue;
+            if ( !same( e.stamp, p_stamp))
+                return false;
+            memcpy( p_digest, e.digest, 32);
+            if ( --e.remaining == 0)
+                e.stamp = FileStamp();
+            else
+                e.used = m_tick++;
+            return true;
+        }
+        return false;
+    }
+
+    /* description:    stores the digest of the inode of p_stamp, read by one of its p_stamp.nlink links
+       return value:   none                                                                                        */
+    void store(const FileStamp &p_stamp, const ArraySpan<u8> &p_digest) noexcept {
+        if ( p_stamp.nlink < 2 || !p_stamp.valid())
+            return;
+        Entry* entries = set( p_stamp);
+        std::lock_guard<std::mutex> guard( lock( entries));
+        Entry* victim = &entries[0];
+        for (u32 i = 0; i < cWays; i++) {
+            Entry &e = entries[i];
+            if ( e.stamp.valid() && e.stamp.dev == p_stamp.dev && e.stamp.ino == p_stamp.ino) {
+                victim = &e;  // read again meanwhile, by another thread or changed
+                break;
+            }
+            if ( !e.stamp.valid())
+                victim = &e;
+            else if ( victim->stamp.valid() && (i32)(e.used - victim->used) < 0)
+                victim = &e;
+        }
+        victim->stamp = p_stamp;
+        u8 i = 0;
+        for (const u8 b : p_digest)
+            victim->digest[i++] = b;
+        victim->remaining = p_stamp.nlink - 1;
+        victim->used = m_tick++;
+    }
+};
+
+#endif
+#endif /* linkmap_hpp */
@@ -0,0 +1,254 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Reading a manifest: the records TYPE|mode|size|hash|dir/|name written by sha256files, or the lines <hash>  <path> of   *
+ *   sha256sum. A text manifest is converted to a binary one first, its entries taken as records; a binary manifest is      *
+ *   mapped as it is. Either is read by the indexes of BinaryManifest, without parsing text again: an entry is found by     *
+ *   its path, the entries not found are walked in the order written.                                                       *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef manifest_hpp
+#define manifest_hpp
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "base.hpp"
+#include "binmanifest.hpp"
+
+VERSION( manifest_hpp, 0, 1, 0, 0);
+
+/* an entry of a text manifest; dir and name point into the key buffer given to parse()                              */
+struct ManifestEntry {
+    static constexpr u64 cSizeUnknown = ~(u64)0;  // sha256sum lines and error records
+    static constexpr u32 cKeyMax      = 8192;     // dir and name, each 0 terminated
+
+    char type[5]     = { 0 };  // as in the record, "FILE" for sha256sum lines
+    i32  mode        = -1;     // -1 if none
+    u64  size        = cSizeUnknown;
+    int  error       = 0;      // errno of an error record
+    bool hashed      = false;
+    bool sum         = false;  // of a sha256sum list
+    u8   hash[32]    = { 0 };
+    const char* dir  = nullptr;
+    const char* name = nullptr;
+
+    constexpr ArraySpan<u8> digest()                               noexcept { return ArraySpan<u8>({ &hash[0], &hash[32] }); }
+
+    /* description:    parses p_line, 0 terminated without its newline. Relative paths of sha256sum lines are taken
+                       relative to p_root. CHNK records of --tree and lines of no manifest are not parsed
+       return value:   false, if the line is no entry                                                              */
+    bool parse(const char* p_line, const char* p_root, char (&p_key)[cKeyMax]) noexcept {
+        *this = ManifestEntry();
+        const size_t len = strlen( p_line);
+        if ( len > 88 && p_line[4] == '|' && p_line[9] == '|' && p_line[22] == '|' && p_line[87] == '|')
+            return parseRecord( p_line, len, p_key);
+        return parseSum( p_line, len, p_root, p_key);
+    }
+
+    /* description:    parses TYPE|mode|size|hash| of a record, 88 characters, not dir and name
+       return value:   false, if the size is no number nor an error                                                */
+    bool parseFields(const char* p_record) noexcept {
+        memcpy( type, p_record, 4);
+        if ( p_record[5] != ' ')
+            mode = (i32)strtol( p_record + 5, nullptr, 8);
+        if ( p_record[10] == '#')
+            error = (int)strtol( p_record + 11, nullptr, 10);
+        else {
+            char* end = nullptr;
+            size = strtoull( p_record + 10, &end, 10);
+            if ( end != p_record + 22)
+                return false;
+        }
+        hashed = p_record[23] != ' ' && parseHash( p_record + 23);
+        return true;
+    }
+private:
+    static int hexDigit(const char c) noexcept {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    }
+    bool parseHash(const char* p_hex) noexcept {
+        for (u32 i = 0; i < 32; i++) {
+            const int high = hexDigit( p_hex[2 * i]), low = hexDigit( p_hex[2 * i + 1]);
+            if ( high < 0 || low < 0)
+                return false;
+            hash[i] = (u8)(high << 4 | low);
+        }
+        return true;
+    }
+    // dir and name into p_key, the name after the last separator
+    bool setKey(const char* p_dir, const size_t p_dir_len, const char* p_name, char (&p_key)[cKeyMax]) noexcept {
+        const size_t name_len = strlen( p_name);
+        if ( p_dir_len + name_len + 2 > cKeyMax)
+            return false;
+        memcpy( p_key, p_dir, p_dir_len);
+        p_key[p_dir_len] = 0;
+        memcpy( p_key + p_dir_len + 1, p_name, name_len + 1);
+        dir = p_key;
+        name = p_key + p_dir_len + 1;
+        return true;
+    }
+
+    // TYPE|mode|size|hash|dir/|name, the name holds no '/', the last "/|" ends the dir
+    bool parseRecord(const char* p_line, const size_t p_len, char (&p_key)[cKeyMax]) noexcept {
+        if ( strncmp( p_line, "CHNK", 4) == 0 || !parseFields( p_line))
+            return false;
+        const char* rest = p_line + 88;
+        for (const char* p = p_line + p_len - 1; p > rest; p--)
+            if ( p[0] == '|' && p[-1] == '/')
+                return setKey( rest, p - 1 - rest, p + 1, p_key);
+        return false;
+    }
+
+    // <hash>  <path> or <hash> *<path>, a leading '\' tells of \\ and \n escaped in the path
+    bool parseSum(const char* p_line, const size_t p_len, const char* p_root, char (&p_key)[cKeyMax]) noexcept {
+        const bool escaped = p_line[0] == '\\';
+        const char* hex = p_line + (escaped ? 1 : 0);
+        if ( p_len < (escaped ? 68u : 67u) || hex[64] != ' ' || (hex[65] != ' ' && hex[65] != '*') || !parseHash( hex))
+            return false;
+        char path[cKeyMax];
+        size_t path_len = 0;
+        const char* p = hex + 66;
+        if ( p[0] != '/') {  // relative to the root
+            for (path_len = strlen( p_root); path_len > 1 && p_root[path_len - 1] == '/'; path_len--) ;
+            if ( path_len + 1 >= cKeyMax)
+                return false;
+            memcpy( path, p_root, path_len);
+            if ( path_len != 1 || p_root[0] != '/')
+                path[path_len++] = '/';
+            while (p[0] == '.' && p[1] == '/')
+                p += 2;
+        }
+        for (; *p != 0 && path_len + 1 < cKeyMax; p++) {
+            if ( escaped && p[0] == '\\' && p[1] == 'n')
+                path[path_len++] = '\n', p++;
+            else if ( escaped && p[0] == '\\' && p[1] == '\\')
+                path[path_len++] = '\\', p++;
+            else
+                path[path_len++] = *p;
+        }
+        if ( *p != 0 || path_len == 0 || path[path_len - 1] == '/')
+            return false;
+        path[path_len] = 0;
+        const char* separator = strrchr( path, '/');
+        if ( separator == nullptr)
+            return false;
+        memcpy( type, "FILE", 4);
+        hashed = true;
+        sum = true;
+        return setKey( path, separator == path ? 1 : separator - path, separator + 1, p_key);
+    }
+};
+
+/* a manifest as records: a binary manifest as it is mapped, a text one converted to a binary one on a temporary file
+   first. An entry is found by its path, BinaryManifest::find(), all of them are walked in the order written           */
+class Manifest : Independent {
+    BinaryManifest* m_records = nullptr;
+    u64  m_skipped = 0;
+    u64  m_chunk_size = 0;
+    bool m_sums = false;
+
+    void take(const char* p_line, const char* p_root, BinaryManifestWriter &p_out) {
+        ManifestEntry e;
+        char key[ManifestEntry::cKeyMax];
+        if ( e.parse( p_line, p_root, key)) {
+            const bool known = e.size != ManifestEntry::cSizeUnknown;
+            m_sums |= e.sum;
+            p_out.add( e.type, e.mode, e.error != 0 ? e.error : known ? e.size : 0, (e.hashed ? BinaryManifest::cHashed : 0)
+                | (e.error != 0 ? BinaryManifest::cError : known ? 0 : BinaryManifest::cSizeUnknown), e.hash, e.dir, e.name);
+        }
+        else if ( strlen( p_line) > 22 && strncmp( p_line, "CHNK", 4) == 0) {
+            if ( m_chunk_size == 0)  // the first chunk of a tree is a whole one
+                m_chunk_size = strtoull( p_line + 10, nullptr, 10);
+        }
+        else if ( p_line[0] != 0 && p_line[0] != '*')
+            m_skipped++;
+    }
+
+    // the entries of the text manifest p_path to p_out
+    void convert(const char* p_path, const char* p_root, BinaryManifestWriter &p_out) {
+        FILE* in = fopen( p_path, "r");
+        if ( in == nullptr)
+            throw new _Exception( errno, "manifest");
+        char* line = nullptr;
+        size_t capacity = 0;
+        ssize_t len;
+        try {
+            while ((len = getline( &line, &capacity, in)) > 0) {
+                while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+                    line[--len] = 0;
+                take( line, p_root, p_out);
+            }
+        }
+        catch (...) {
+            free( line);
+            fclose( in);
+            throw;
+        }
+        const int error = ferror( in) ? errno : 0;
+        free( line);
+        fclose( in);
+        if ( error != 0)
+            throw new _Exception( error, "manifest");
+    }
+public:
+    /* description:    maps the binary manifest p_path, else converts the text manifest p_path to a temporary one
+                       in $TMPDIR. The paths of sha256sum lists are taken relative to the root p_root
+       error:          of BinaryManifest and BinaryManifestWriter, of fopen and reading                              */
+    Manifest(const char* p_path, const char* p_root) {
+        if ( BinaryManifest::is( p_path)) {
+            m_records = new BinaryManifest( p_path);
+            for (u64 i = 0; i < m_records->count() && m_chunk_size == 0; i++)  // the first chunk of a tree is a whole one
+                if ( strncmp( m_records->record( i).type, "CHNK", 4) == 0)
+                    m_chunk_size = m_records->record( i).size;
+            return;
+        }
+        const char* tmp_dir = getenv( "TMPDIR");
+        char tmp_path[PATH_MAX];
+        snprintf( tmp_path, sizeof( tmp_path), "%s/sha256files-manifest-XXXXXX", tmp_dir != nullptr && *tmp_dir != 0 ? tmp_dir : "/tmp");
+        const int fd = mkstemp( tmp_path);
+        if ( fd < 0)
+            throw new _Exception( errno, "manifest");
+        ::close( fd);
+        try {
+            BinaryManifestWriter out( tmp_path);
+            convert( p_path, p_root, out);
+            out.close( false);
+            m_records = new BinaryManifest( tmp_path);
+        }
+        catch (...) {
+            unlink( tmp_path);
+            throw;
+        }
+        unlink( tmp_path);  // it stays mapped
+    }
+    ~Manifest() { delete m_records; }
+
+    /* description:    the records, found by path or walked                                                         */
+    const BinaryManifest& records()             const noexcept { return *m_records; }
+    u64  skipped()                              const noexcept { return m_skipped; }
+    /* description:    the chunk size of the TREE records, 0 if there are none                                      */
+    u64  chunkSize()                            const noexcept { return m_chunk_size; }
+    /* description:    the manifest is a sha256sum list, of regular files only                                      */
+    bool sums()                                 const noexcept { return m_sums; }
+};
+
+#endif
+#endif /* manifest_hpp */
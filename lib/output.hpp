@@ -0,0 +1,252 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Output of many short records: fields of fixed width are formatted by tables, two digits at a time, without a division *
+ *   loop; every thread collects whole records in blocks of its own and writes them all at once by writev, under a lock.  *
+ *   Records of different threads never mix within a line.                                                                 *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef output_hpp
+#define output_hpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include "base.hpp"
+#include "stats.hpp"
+#include "io.hpp"
+#ifndef _WIN32
+    #include <unistd.h>
+    #include <sys/uio.h>
+#endif
+
+VERSION( output_hpp, 0, 1, 0, 0);
+
+/* "00".."ff" and "00".."99", two digits a lookup                                                                      */
+struct FormatTables {
+    char hex[512];
+    char decimal[200];
+    constexpr FormatTables() : hex(), decimal() {
+        for (int i = 0; i < 256; i++) {
+            hex[2 * i]     = "0123456789abcdef"[i >> 4];
+            hex[2 * i + 1] = "0123456789abcdef"[i & 0x0f];
+        }
+        for (int i = 0; i < 100; i++) {
+            decimal[2 * i]     = (char)('0' + i / 10);
+            decimal[2 * i + 1] = (char)('0' + i % 10);
+        }
+    }
+};
+
+class Format : Static {
+    static constexpr FormatTables cTables {};
+public:
+    /* description:    p_len bytes as 2 * p_len lower case hex digits
+       return value:   the end of what was written                                                                 */
+    static char* hex(char* p_dst, const u8* p_src, const u64 p_len) noexcept {
+        for (u64 i = 0; i < p_len; i++, p_dst += 2)
+            memcpy( p_dst, &cTables.hex[2 * p_src[i]], 2);
+        return p_dst;
+    }
+    /* description:    p_v right aligned in p_width, filled with p_space, wider if it needs more digits. Two digits
+                       a step by the table, the division by the constant 100 is a multiplication
+       return value:   the end of what was written                                                                 */
+    static char* decimal(char* p_dst, u64 p_v, const u32 p_width, const char p_space = ' ') noexcept {
+        char digits[20];
+        char* p = &digits[20];
+        while (p_v >= 100) {
+            const u64 q = p_v / 100;
+            p -= 2;
+            memcpy( p, &cTables.decimal[2 * (p_v - q * 100)], 2);
+            p_v = q;
+        }
+        if ( p_v >= 10) {
+            p -= 2;
+            memcpy( p, &cTables.decimal[2 * p_v], 2);
+        }
+        else
+            *--p = (char)('0' + p_v);
+        const u32 len = (u32)(&digits[20] - p);
+        for (u32 i = len; i < p_width; i++)
+            *p_dst++ = p_space;
+        memcpy( p_dst, p, len);
+        return p_dst + len;
+    }
+    /* description:    the p_width lowest octal digits of p_v, by shifts
+       return value:   the end of what was written                                                                 */
+    static char* octal(char* p_dst, const u32 p_v, const u32 p_width) noexcept {
+        for (u32 i = 0; i < p_width; i++)
+            p_dst[i] = (char)('0' + ((p_v >> (3 * (p_width - 1 - i))) & 7));
+        return p_dst + p_width;
+    }
+};
+
+/* a line in the making, of SIZE characters at most, 0 terminated                                                     */
+template <u32 SIZE>
+struct FieldText {
+    char text[SIZE + 1];
+    u32  len = 0;
+
+    FieldText() noexcept { text[0] = 0; }
+    FieldText& reset()                                         noexcept { len = 0; text[0] = 0; return *this; }
+    const char* begin()                                  const noexcept { return text; }
+    FieldText& put(const char* p_s, const u32 p_len)           noexcept {
+        const u32 n = min<u32>( p_len, SIZE - len);
+        memcpy( text + len, p_s, n);
+        len += n;
+        text[len] = 0;
+        return *this;
+    }
+    FieldText& put(const char* p_s)                            noexcept { return put( p_s, (u32)strlen( p_s)); }
+    FieldText& put(const char p_c)                             noexcept { return put( &p_c, 1); }
+    FieldText& hex(const u8* p_src, const u64 p_len)           noexcept {
+        if ( len + 2 * p_len <= SIZE)
+            len = (u32)(Format::hex( text + len, p_src, p_len) - text);
+        text[len] = 0;
+        return *this;
+    }
+    FieldText& decimal(const u64 p_v, const u32 p_width, const char p_space = ' ') noexcept {
+        if ( len + max<u32>( p_width, 20) <= SIZE)
+            len = (u32)(Format::decimal( text + len, p_v, p_width, p_space) - text);
+        text[len] = 0;
+        return *this;
+    }
+    FieldText& octal(const u32 p_v, const u32 p_width)         noexcept {
+        if ( len + p_width <= SIZE)
+            len = (u32)(Format::octal( text + len, p_v, p_width) - text);
+        text[len] = 0;
+        return *this;
+    }
+};
+
+/* the records of a thread, written by flush() whole; OutputBuffer::local() is the one of the calling thread, flushed
+   at its end                                                                                                         */
+class OutputBuffer : Independent {
+public:
+    static constexpr u64 cBlockSize = 64 * 1024;
+    static constexpr u32 cBlocks    = 16;
+
+private:
+    static inline std::recursive_mutex s_lock;  // one flush at a time, held by a Group
+    static inline int s_fd = 1;
+    char* m_blocks[cBlocks] = { nullptr };
+    u64   m_used[cBlocks] = { 0 };
+    u32   m_block = 0;
+
+    bool writeAll(const int p_fd, const char* p_data, const u64 p_len) noexcept {
+#ifndef _WIN32
+        return File::writeAll( p_fd, p_data, p_len);
+#else
+        return fwrite( p_data, 1, p_len, stdout) == p_len;
+#endif
+    }
+public:
+    OutputBuffer() noexcept { }
+    ~OutputBuffer() {
+        flush();
+        for (u32 i = 0; i < cBlocks; i++)
+            free( m_blocks[i]);
+    }
+
+    /* description:    the buffer of the calling thread                                                            */
+    static OutputBuffer& local() noexcept {
+        static thread_local OutputBuffer buffer;
+        return buffer;
+    }
+    /* description:    the descriptor written to, stdout by default                                                */
+    static void setDescriptor(const int p_fd) noexcept { s_fd = p_fd; }
+
+    /* holds back the flushes of the other threads: the records appended meanwhile by this one follow each other
+       in the output, all of them, even beyond the size of a buffer                                                   */
+    class Group : Static {
+    public:
+        Group() { s_lock.lock(); }
+        ~Group() {
+            local().flush();
+            s_lock.unlock();
+        }
+    };
+
+    /* description:    appends the p_count pieces as one record, cBlockSize at most; flushes first, if the buffer
+                       is full
+       error:          ENOMEM                                                                                      */
+    void append(const char* const* p_pieces, const u64* p_lens, const u32 p_count) {
+        u64 len = 0;
+        for (u32 i = 0; i < p_count; i++)
+            len += p_lens[i];
+        if ( m_used[m_block] + len > cBlockSize) {
+            if ( m_block + 1 == cBlocks)
+                flush();
+            else if ( m_used[m_block] > 0)
+                m_block++;
+        }
+        if ( m_blocks[m_block] == nullptr && (m_blocks[m_block] = (char*)malloc( cBlockSize)) == nullptr)
+            throw new _Exception( ENOMEM, "output buffer");
+        char* p = m_blocks[m_block] + m_used[m_block];
+        for (u32 i = 0; i < p_count; i++) {
+            const u64 n = min<u64>( p_lens[i], cBlockSize - m_used[m_block]);
+            memcpy( p, p_pieces[i], n);
+            p += n;
+            m_used[m_block] += n;
+        }
+    }
+    void append(const char* p_text) {
+        const u64 len = strlen( p_text);
+        append( &p_text, &len, 1);
+    }
+
+    /* description:    writes the blocks filled, in one writev if the descriptor takes it whole
+       return value:   none, errors of writing are dropped as those of stdio                                       */
+    void flush() noexcept {
+        if ( m_used[0] == 0)
+            return;
+        std::lock_guard<std::recursive_mutex> guard( s_lock);
+        const u64 start = Stats::start();
+        u64 total = 0;
+        for (u32 i = 0; i <= m_block; i++)
+            total += m_used[i];
+#ifndef _WIN32
+        struct iovec iov[cBlocks];
+        u32 count = 0;
+        u64 len = 0;
+        for (; count <= m_block && m_used[count] > 0; count++) {
+            iov[count].iov_base = m_blocks[count];
+            iov[count].iov_len = m_used[count];
+            len += m_used[count];
+        }
+        ssize_t written;
+        while ((written = writev( s_fd, iov, count)) < 0 && errno == EINTR) ;
+        if ( written >= 0 && (u64)written < len) {  // the rest one by one, pipes take less at times
+            for (u32 i = 0; i < count; i++) {
+                const u64 skip = min<u64>( (u64)written, iov[i].iov_len);
+                written -= skip;
+                if ( !writeAll( s_fd, (const char*)iov[i].iov_base + skip, iov[i].iov_len - skip))
+                    break;
+            }
+        }
+#else
+        for (u32 i = 0; i <= m_block; i++)
+            writeAll( s_fd, m_blocks[i], m_used[i]);
+#endif
+        Stats::stop( Stats::cOutput, start, total);
+        for (u32 i = 0; i <= m_block; i++)
+            m_used[i] = 0;
+        m_block = 0;
+    }
+};
+
+#endif /* output_hpp */
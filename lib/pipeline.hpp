@@ -0,0 +1,220 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Reading and hashing in two stages of threads: readers fill buffers of a fixed pool and pass them on to the hashers    *
+ *   by lock free bounded queues. All chunks of a file go to the same hasher, in the order read. The pool caps the memory  *
+ *   in flight; a reader without a free buffer waits for the hashers, the disk and the processors stay busy both.          *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef pipeline_hpp
+#define pipeline_hpp
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "base.hpp"
+#include "sha256.hpp"
+#include "io.hpp"
+#include "pool.hpp"
+
+VERSION( pipeline_hpp, 0, 1, 0, 0);
+
+class HashPipeline : Independent {
+public:
+    static constexpr u32 cThreadsMax      = 256;
+    static constexpr u64 cInflightDefault = 64 * 1024 * 1024;
+    static constexpr u64 cJobsQueued      = 1024;
+
+    struct Result {
+        const char* dir;
+        const char* name;
+        i32  mode;   // st_mode, -1 if fstat failed
+        int  error;  // errno of open, 0 if opened
+        u64  size;   // bytes read
+        Sha256 &sha;
+        FileStamp stamp;  // by fstat, invalid if it failed
+        u64  start;       // Stats::start() when queued
+    };
+    typedef void (*Done)( Result &p_result);
+
+private:
+    struct Job : Independent {
+        char*  dir;   // dir, name and path in one allocation
+        char*  name;
+        char*  path;
+        u32    hasher;
+        i32    mode  = -1;
+        int    error = 0;
+        Sha256 sha;
+        FileStamp stamp;
+        u64    start = Stats::start();
+        Job(const char* p_root_dir, const char* p_file_name, const char* p_path, const u32 p_hasher) : hasher( p_hasher) {
+            const size_t dir_len = strlen( p_root_dir) + 1, name_len = strlen( p_file_name) + 1, path_len = strlen( p_path) + 1;
+            dir = (char*)malloc( dir_len + name_len + path_len);
+            if ( dir == nullptr)
+                throw new _Exception( ENOMEM, "pipeline job");
+            name = dir + dir_len;
+            path = name + name_len;
+            memcpy( dir, p_root_dir, dir_len);
+            memcpy( name, p_file_name, name_len);
+            memcpy( path, p_path, path_len);
+        }
+        ~Job() { free( dir); }
+    };
+    struct Chunk {
+        Job* job;
+        u8*  data;  // nullptr: the end of the file
+        u64  len;
+    };
+
+    const Done m_done;
+    const u32 m_readers;
+    const u32 m_hashers;
+    const u64 m_buffer_size;
+    u64 m_buffers = 0;               // in the pool, the readers hold one more each
+    BoundedQueue<Job*> m_jobs;
+    BoundedQueue<u8*> m_pool;
+    BoundedQueue<Chunk>** m_chunks;  // one per hasher
+    std::thread* m_threads;
+    std::atomic<bool> m_closing { false };
+    std::atomic<u32> m_readers_running;
+    std::atomic<u32> m_next_hasher { 0 };
+
+    u8* takeBuffer() noexcept {
+        u8* buffer = nullptr;
+        Backoff backoff;
+        while (!m_pool.tryPop( buffer))
+            backoff.wait();
+        return buffer;
+    }
+
+    void read() {
+        FileReader reader( m_buffer_size);
+        Backoff idle;
+        Job* job = nullptr;
+        for (;;) {
+            const bool closing = m_closing;  // then all files are queued already
+            if ( !m_jobs.tryPop( job)) {
+                if ( closing)
+                    break;
+                idle.wait();
+                continue;
+            }
+            idle.reset();
+            BoundedQueue<Chunk> &chunks = *m_chunks[job->hasher];
+            const u64 start = Stats::start();
+            const int fd = ::open( job->path, O_RDONLY | O_CLOEXEC);
+            Stats::stop( Stats::cOpen, start, 0, job->name);
+            if ( fd < 0)
+                job->error = errno;
+            else {
+                Throttle::open();
+                struct stat sb;
+                if ( fstat( fd, &sb) == 0) {
+                    job->mode = sb.st_mode;
+                    job->stamp = FileStamp::of( sb);
+                }
+                reader.stream( fd, [&]( const u8*, const u64 p_len) {  // the hasher gets the buffer read into
+                    chunks.push( Chunk{ job, reader.exchangeBuffer( takeBuffer()), p_len });
+                });
+                ::close( fd);
+            }
+            chunks.push( Chunk{ job, nullptr, 0});
+        }
+        m_readers_running--;
+    }
+
+    void hash(const u32 p_hasher) {
+        BoundedQueue<Chunk> &chunks = *m_chunks[p_hasher];
+        Backoff idle;
+        Chunk chunk;
+        for (;;) {
+            const bool readers_done = m_readers_running == 0;  // then all they pushed is queued already
+            if ( !chunks.tryPop( chunk)) {
+                if ( readers_done)
+                    break;
+                idle.wait();
+                continue;
+            }
+            idle.reset();
+            if ( chunk.data != nullptr) {
+                const u64 start = Stats::start();
+                chunk.job->sha.update( chunk.data, chunk.len);
+                Stats::stop( Stats::cHash, start, chunk.len, chunk.job->name);
+                Throttle::work();
+                m_pool.push( chunk.data);
+            }
+            else {
+                Result result = { chunk.job->dir, chunk.job->name, chunk.job->mode, chunk.job->error,
+                                  chunk.job->sha.payloadLen(), chunk.job->sha, chunk.job->stamp, chunk.job->start };
+                m_done( result);
+                delete chunk.job;
+            }
+        }
+    }
+public:
+    /* description:    starts p_readers reading and p_hashers hashing threads, with buffers of FileReader::bufferSize()
+                       summing up to p_inflight bytes, but one per reader and one more at least
+       error:          ENOMEM                                                                                      */
+    HashPipeline(const Done p_done, const u32 p_readers, const u32 p_hashers, const u64 p_inflight = cInflightDefault)
+        : m_done( p_done), m_readers( max<u32>( p_readers, 1)), m_hashers( max<u32>( p_hashers, 1)),
+          m_buffer_size( FileReader::bufferSize()), m_jobs( cJobsQueued),
+          m_pool( max<u64>( p_inflight / FileReader::bufferSize(), m_readers + 1)),
+          m_readers_running( m_readers) {
+        const u64 buffers = max<u64>( p_inflight / m_buffer_size, m_readers + 1) - m_readers;
+        for (; m_buffers < buffers; m_buffers++)
+            m_pool.push( FileReader::allocateBuffer( m_buffer_size));
+        m_chunks = new BoundedQueue<Chunk>*[m_hashers];
+        for (u32 i = 0; i < m_hashers; i++)
+            m_chunks[i] = new BoundedQueue<Chunk>( m_buffers + m_readers);
+        m_threads = new std::thread[m_readers + m_hashers];
+        for (u32 i = 0; i < m_readers; i++)
+            m_threads[i] = std::thread( [this]() { read(); });
+        for (u32 i = 0; i < m_hashers; i++)
+            m_threads[m_readers + i] = std::thread( [this, i]() { hash( i); });
+    }
+    ~HashPipeline() {
+        flush();
+        delete[] m_threads;
+        for (u32 i = 0; i < m_hashers; i++)
+            delete m_chunks[i];
+        delete[] m_chunks;
+        u8* buffer = nullptr;
+        while (m_pool.tryPop( buffer))
+            FileReader::freeBuffer( buffer);
+    }
+
+    /* description:    queues the file p_path, known to the output as p_root_dir / p_file_name; waits while the
+                       queue of files is full
+       return value:   none, the result goes to the Done callback, on a hashing thread                             */
+    void add(const char* p_root_dir, const char* p_file_name, const char* p_path) {
+        m_jobs.push( new Job( p_root_dir, p_file_name, p_path, m_next_hasher++ % m_hashers));
+    }
+
+    /* description:    waits till all files queued are done and stops the threads                                  */
+    void flush() {
+        m_closing = true;
+        for (u32 i = 0; i < m_readers + m_hashers; i++)
+            if ( m_threads[i].joinable())
+                m_threads[i].join();
+    }
+};
+
+#endif
+#endif /* pipeline_hpp */
@@ -0,0 +1,253 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, using c++ ISO/IEC 14882:2017 threads                                                            *
+ *                                                                                                                          *
+ *   Work stealing: every worker thread has its own deque. Tasks found while running a task are pushed onto the deque of   *
+ *   the worker, which pops them from the back again, depth first. A worker running dry steals from the front of the       *
+ *   deque of another one, the oldest tasks, usually the largest subtrees.                                                  *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef pool_hpp
+#define pool_hpp
+
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include "base.hpp"
+
+VERSION( pool_hpp, 0, 1, 0, 0);
+
+/* waiting of a thread for work: yields first, sleeps after cSpinRounds in vain                                       */
+class Backoff : Static {
+    static constexpr u32 cSpinRounds = 64;
+    u32 m_rounds = 0;
+public:
+    void wait() noexcept {
+        if ( ++m_rounds < cSpinRounds)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for( std::chrono::microseconds( 100));
+    }
+    void reset() noexcept { m_rounds = 0; }
+};
+
+/* lock free bounded queue for many producers and consumers, by D. Vyukov: every cell has a sequence number, telling
+   the lap of the queue it may be written or read in. T is copied in and out                                          */
+template <typename T>
+class BoundedQueue : Independent {
+    struct Cell {
+        std::atomic<u64> sequence;
+        T value;
+    };
+    Cell* m_cells;
+    const u64 m_mask;
+    alignas( 64) std::atomic<u64> m_enqueue { 0 };
+    alignas( 64) std::atomic<u64> m_dequeue { 0 };
+
+    static u64 capacity(const u64 p_capacity) noexcept {
+        u64 capacity = 2;
+        while (capacity < p_capacity)
+            capacity *= 2;
+        return capacity;
+    }
+public:
+    /* description:    p_capacity is rounded up to a power of 2                                                     */
+    explicit BoundedQueue(const u64 p_capacity) : m_mask( capacity( p_capacity) - 1) {
+        m_cells = new Cell[m_mask + 1];
+        for (u64 i = 0; i <= m_mask; i++)
+            m_cells[i].sequence.store( i, std::memory_order_relaxed);
+    }
+    ~BoundedQueue() { delete[] m_cells; }
+
+    /* return value:   false, if full                                                                               */
+    bool tryPush(const T &p_value) noexcept {
+        u64 pos = m_enqueue.load( std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            const i64 lap = (i64)(cell.sequence.load( std::memory_order_acquire) - pos);
+            if ( lap < 0)
+                return false;
+            if ( lap > 0)
+                pos = m_enqueue.load( std::memory_order_relaxed);
+            else if ( m_enqueue.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = p_value;
+                cell.sequence.store( pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    /* return value:   false, if empty                                                                              */
+    bool tryPop(T &p_value) noexcept {
+        u64 pos = m_dequeue.load( std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            const i64 lap = (i64)(cell.sequence.load( std::memory_order_acquire) - (pos + 1));
+            if ( lap < 0)
+                return false;
+            if ( lap > 0)
+                pos = m_dequeue.load( std::memory_order_relaxed);
+            else if ( m_dequeue.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed)) {
+                p_value = cell.value;
+                cell.sequence.store( pos + m_mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    /* description:    waits while the queue is full                                                                */
+    void push(const T &p_value) noexcept {
+        Backoff backoff;
+        while (!tryPush( p_value))
+            backoff.wait();
+    }
+};
+
+/* tasks T are allocated by new, the deque owns them till they are taken                                              */
+template <typename T>
+class WorkDeque : Independent {
+    static constexpr u64 cCapacityMin = 256;
+    std::mutex m_lock;
+    T** m_items = nullptr;
+    u64 m_capacity = 0;  // power of 2
+    u64 m_front = 0;     // m_front..m_back, counting up, taken modulo m_capacity
+    u64 m_back = 0;
+
+    void grow() {
+        const u64 capacity = m_capacity == 0 ? cCapacityMin : 2 * m_capacity;
+        T** items = (T**)malloc( capacity * sizeof( T*));
+        if ( items == nullptr)
+            throw new _Exception( ENOMEM, "work deque");
+        for (u64 i = m_front; i < m_back; i++)
+            items[i & (capacity - 1)] = m_items[i & (m_capacity - 1)];
+        free( m_items);
+        m_items = items;
+        m_capacity = capacity;
+    }
+public:
+    WorkDeque() noexcept { }
+    ~WorkDeque() {
+        for (T* t = pop(); t != nullptr; t = pop())
+            delete t;
+        free( m_items);
+    }
+
+    void push(T* p_task) {
+        std::lock_guard<std::mutex> guard( m_lock);
+        if ( m_back - m_front == m_capacity)
+            grow();
+        m_items[m_back++ & (m_capacity - 1)] = p_task;
+    }
+    /* description:    takes the newest task, by the owner
+       return value:   nullptr, if empty                                                                            */
+    T* pop() noexcept {
+        std::lock_guard<std::mutex> guard( m_lock);
+        return m_back == m_front ? nullptr : m_items[--m_back & (m_capacity - 1)];
+    }
+    /* description:    takes the oldest task, by another worker
+       return value:   nullptr, if empty                                                                            */
+    T* steal() noexcept {
+        std::lock_guard<std::mutex> guard( m_lock);
+        return m_back == m_front ? nullptr : m_items[m_front++ & (m_capacity - 1)];
+    }
+};
+
+template <typename T>
+class WorkStealingPool : Independent {
+    static inline thread_local u32 t_worker = 0;
+    const u32 m_workers;
+    WorkDeque<T>* m_deques;
+    std::atomic<u64> m_pending { 0 };  // tasks pushed and not done yet
+    std::atomic<bool> m_failed { false };
+    std::mutex m_error_lock;
+    std::exception_ptr m_error;
+
+    T* take(const u32 p_worker) noexcept {
+        T* task = m_deques[p_worker].pop();
+        for (u32 i = 1; task == nullptr && i < m_workers; i++)
+            task = m_deques[(p_worker + i) % m_workers].steal();
+        return task;
+    }
+
+    template <typename ENTER, typename RUN, typename LEAVE>
+    void work(const u32 p_worker, ENTER &p_enter, RUN &p_run, LEAVE &p_leave) noexcept {
+        t_worker = p_worker;
+        try {
+            p_enter();
+            Backoff idle;
+            while ( !m_failed) {
+                T* task = take( p_worker);
+                if ( task == nullptr) {
+                    if ( m_pending == 0)
+                        break;
+                    idle.wait();
+                    continue;
+                }
+                idle.reset();
+                try {
+                    p_run( *task);  // pushes the tasks it finds, before this one is done
+                }
+                catch (...) {
+                    delete task;
+                    throw;
+                }
+                delete task;
+                m_pending--;
+            }
+            p_leave();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> guard( m_error_lock);
+            if ( !m_failed.exchange( true))
+                m_error = std::current_exception();
+        }
+    }
+public:
+    explicit WorkStealingPool(const u32 p_workers) : m_workers( max<u32>( p_workers, 1)) {
+        m_deques = new WorkDeque<T>[m_workers];
+    }
+    ~WorkStealingPool() { delete[] m_deques; }
+
+    /* description:    count of worker threads, 0 asks for one per processor                                        */
+    static u32 workers(const u32 p_workers) noexcept {
+        return p_workers > 0 ? p_workers : max<u32>( std::thread::hardware_concurrency(), 1);
+    }
+
+    /* description:    queues a task, on the deque of the calling worker; ahead of run() on the one of the first     */
+    void push(T* p_task) {
+        m_pending++;
+        m_deques[t_worker].push( p_task);
+    }
+
+    /* description:    runs the tasks on the worker threads by p_run( T&), till all are done. Each worker calls
+                       p_enter() at its start and p_leave() at its end
+       error:          the first exception thrown by them, rethrown after all workers stopped                      */
+    template <typename ENTER, typename RUN, typename LEAVE>
+    void run(ENTER &&p_enter, RUN &&p_run, LEAVE &&p_leave) {
+        std::thread* threads = new std::thread[m_workers - 1];
+        for (u32 i = 1; i < m_workers; i++)
+            threads[i - 1] = std::thread( [this, i, &p_enter, &p_run, &p_leave]() { work( i, p_enter, p_run, p_leave); });
+        work( 0, p_enter, p_run, p_leave);  // the calling thread is worker 0
+        for (u32 i = 1; i < m_workers; i++)
+            threads[i - 1].join();
+        delete[] threads;
+        t_worker = 0;
+        if ( m_failed)
+            std::rethrow_exception( m_error);
+    }
+};
+
+#endif /* pool_hpp */
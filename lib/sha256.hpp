@@ -8,29 +8,34 @@
  *                                                                                                                          *
  *   written in simple C++, POSIX compatibility for Environmental requirements, alternativ for windows to                   *
  *   using c++ ISO/IEC 14882:2011, Reference: https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf                    *
+ *   x86 SHA extensions: Intel(R) SHA Extensions, https://www.intel.com/content/dam/develop/external/us/en/documents/      *
+ *                       intel-sha-extensions-white-paper-402097.pdf                                                        *
  *                                                                                                                          *
  ****************************************************************************************************************************///
 
 #ifndef sha256_h
 #define sha256_h
 
+#include <string.h>
 #include "base.hpp"
+#include "shablocks.hpp"
+#if ISA_X86
+    #include <immintrin.h>
+#endif
 
 VERSION(sha256_hpp, 0, 2, 0, 3);
 
-class Sha256 {
+class Sha256 : public ShaBlocks< Sha256, u32, 64> {
+    friend class Sha256MultiBuffer; // shares the round constants and the initial hash value
+    friend class ShaBlocks< Sha256, u32, 64>;
 private:
     bool finished = false;
-    u8  buffer_filled = 0;
-    u64 contendlen = 0;
     u32 hs32[8] = { 0 };
     static constexpr u8 SHA256_BLOCK_SIZE = 32;             // SHA256 outputs a 32 byte digest
-    static constexpr u8 bufferSizeAs32b = 64;
     static constexpr u8 size_payload_buffer_as32bit = 16;
 public:
-    static constexpr u8 size_payload_buffer_as08bit = 4 * size_payload_buffer_as32bit;
+    static constexpr const char cName[] = "sha256";        // of the digest in the records of other hashers
 private:
-    BytesOfScalar< u32, Endianes::Big> payload_buffer_as32bit[ bufferSizeAs32b] = { 0 };
     DArrayContainer< u8, SHA256_BLOCK_SIZE> m_hash;
 
     typedef const u32 u32c;
@@ -49,64 +54,166 @@ private:
     };
 
     static constexpr u32c rot_r(const u32c a, const u32c b)               noexcept { return (a >> b) | (a << (32 - b)); }
-    static constexpr u32c ch(   const u32c x, const u32c y, const u32c z) noexcept { return (x &  y) ^ (~x &  z); }
-    static constexpr u32c maj(  const u32c x, const u32c y, const u32c z) noexcept { return (x &  y) ^ (x &  z) ^ (y & z); }
+    static constexpr u32c ch(   const u32c x, const u32c y, const u32c z) noexcept { return z ^ (x & (y ^ z)); }        // (x & y) ^ (~x & z)
+    static constexpr u32c maj(  const u32c x, const u32c y, const u32c z) noexcept { return (x & y) | (z & (x | y)); }      // (x & y) ^ (x & z) ^ (y & z)
     static constexpr u32c ep0(  const u32c x)                             noexcept { return (rot_r(x, 2) ^ rot_r(x, 13) ^ rot_r(x, 22)); }
     static constexpr u32c ep1(  const u32c x)                             noexcept { return (rot_r(x, 6) ^ rot_r(x, 11) ^ rot_r(x, 25)); }
     static constexpr u32c sig0( const u32c x)                             noexcept { return (rot_r(x, 7) ^ rot_r(x, 18) ^ ((x) >> 3)); }
     static constexpr u32c sig1( const u32c x)                             noexcept { return (rot_r(x, 17) ^ rot_r(x, 19) ^ ((x) >> 10)); }
 
-    constexpr void
-        process_buffer() noexcept {
-        // 6.2.2 SHA-256 Hash Computation
-        // buffer32b[ 0..15] is already filled by payload 8bit[ 0..63]
-        // prepare [16..63]
-        for (u8 i = size_payload_buffer_as32bit; i < bufferSizeAs32b; i++)
-            payload_buffer_as32bit[i].m_v = sig1(payload_buffer_as32bit[i - 2].m_v)
-            + payload_buffer_as32bit[i - 7].m_v
-            + sig0(payload_buffer_as32bit[i - 15].m_v)
-            + payload_buffer_as32bit[i - 16].m_v;
-
-        u32 a = hs32[0], b = hs32[1], c = hs32[2], d = hs32[3], e = hs32[4], f = hs32[5], g = hs32[6], h = hs32[7];
-
-        for (u8 i = 0; i < bufferSizeAs32b; ++i) {
-            const u32 t1 = h + ep1(e) + ch(e, f, g) + k[i] + payload_buffer_as32bit[i].m_v;
-            const u32 t2 = ep0(a) + maj(a, b, c);
-            h = g;
-            g = f;
-            f = e;
-            e = d + t1;
-            d = c;
-            c = b;
-            b = a;
-            a = t1 + t2;
+    // 5.2.1 Parsing the Message, words are big endian
+    static constexpr u32  load_be32(const u8* p)                          noexcept {
+        return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+    }
+
+    // 6.2.2 SHA-256 Hash Computation, straight from the message; the schedule rolls over 16 words instead of 64
+    static constexpr void
+    process_blocks_scalar( u32 (&p_hs32)[8], const u8* p_data, u64 p_blocks) noexcept {
+        for (; p_blocks > 0; p_blocks--, p_data += size_payload_buffer_as08bit) {
+            u32 w[size_payload_buffer_as32bit] = { 0 };
+            u32 a = p_hs32[0], b = p_hs32[1], c = p_hs32[2], d = p_hs32[3], e = p_hs32[4], f = p_hs32[5], g = p_hs32[6], h = p_hs32[7];
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 64
+#endif
+            for (u8 i = 0; i < 64; ++i) {
+                if (i < 16)
+                    w[i] = load_be32( p_data + 4 * i);
+                else
+                    w[i & 15] += sig1(w[(i - 2) & 15]) + w[(i - 7) & 15] + sig0(w[(i - 15) & 15]);
+                const u32 t1 = h + ep1(e) + ch(e, f, g) + k[i] + w[i & 15];
+                const u32 t2 = ep0(a) + maj(a, b, c);
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            p_hs32[0] += a; p_hs32[1] += b; p_hs32[2] += c; p_hs32[3] += d; p_hs32[4] += e; p_hs32[5] += f; p_hs32[6] += g; p_hs32[7] += h;
+        }
+    }
+
+    // blocks of zeros: the message schedule is zero all through, the rounds add the constants only
+    static void
+    process_zero_blocks_scalar( u32 (&p_hs32)[8], u64 p_blocks) noexcept {
+        for (; p_blocks > 0; p_blocks--) {
+            u32 a = p_hs32[0], b = p_hs32[1], c = p_hs32[2], d = p_hs32[3], e = p_hs32[4], f = p_hs32[5], g = p_hs32[6], h = p_hs32[7];
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 64
+#endif
+            for (u8 i = 0; i < 64; ++i) {
+                const u32 t1 = h + ep1(e) + ch(e, f, g) + k[i];
+                const u32 t2 = ep0(a) + maj(a, b, c);
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            p_hs32[0] += a; p_hs32[1] += b; p_hs32[2] += c; p_hs32[3] += d; p_hs32[4] += e; p_hs32[5] += f; p_hs32[6] += g; p_hs32[7] += h;
+        }
+    }
+
+#if ISA_X86
+    // 6.2.2 SHA-256 Hash Computation on the SHA extensions
+    TARGET_ISA( "sha,sse4.1,ssse3") static void
+    process_blocks_sha_ni( u32 (&p_hs32)[8], const u8* p_data, u64 p_blocks) noexcept {
+        const __m128i shuffle_mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bull, 0x0405060700010203ull); // big endian words
+        // state as ABEF / CDGH as required by sha256rnds2
+        __m128i tmp   = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*)&p_hs32[0]), 0xb1); // CDAB
+        __m128i cdgh  = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*)&p_hs32[4]), 0x1b); // EFGH
+        __m128i abef  = _mm_alignr_epi8( tmp, cdgh, 8);
+        cdgh          = _mm_blend_epi16( cdgh, tmp, 0xf0);
+
+        for (; p_blocks > 0; p_blocks--, p_data += size_payload_buffer_as08bit) {
+            const __m128i abef_save = abef, cdgh_save = cdgh;
+            __m128i msg[4];
+            for (u8 i = 0; i < 4; i++)
+                msg[i] = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*)(p_data + 16 * i)), shuffle_mask);
+            // 16 x 4 rounds, the message schedule rolling over 4 registers
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 16
+#endif
+            for (u8 q = 0; q < 16; q++) {
+                __m128i& w = msg[q & 3];
+                const __m128i wk = _mm_add_epi32( w, _mm_loadu_si128( (const __m128i*)&k[4 * q]));
+                cdgh = _mm_sha256rnds2_epu32( cdgh, abef, wk);
+                abef = _mm_sha256rnds2_epu32( abef, cdgh, _mm_shuffle_epi32( wk, 0x0e));
+                if (q < 12) { // w[t] = sig1(w[t-2]) + w[t-7] + sig0(w[t-15]) + w[t-16]
+                    const __m128i w3 = msg[(q + 3) & 3];
+                    w = _mm_sha256msg1_epu32( w, msg[(q + 1) & 3]);
+                    w = _mm_add_epi32( w, _mm_alignr_epi8( w3, msg[(q + 2) & 3], 4));
+                    w = _mm_sha256msg2_epu32( w, w3);
+                }
+            }
+            abef = _mm_add_epi32( abef, abef_save);
+            cdgh = _mm_add_epi32( cdgh, cdgh_save);
         }
-        hs32[0] += a; hs32[1] += b; hs32[2] += c; hs32[3] += d; hs32[4] += e; hs32[5] += f; hs32[6] += g; hs32[7] += h;
-        buffer_filled = 0;
-    }
-
-    //5.1.2 Padding the Message
-    constexpr inline void padding_the_message_except_space(const u8 up_to_space) {
-        i8 to_fill = size_payload_buffer_as08bit - buffer_filled - up_to_space;
-        if (to_fill >= 0) //ready to pad?
-            while (to_fill--)
-                add_byte(0); //pad
-        else {  // not enough space to pad? => add block
-            padding_the_message_except_space(0); // will fill buffer up, triggers processing block and reset space
-            padding_the_message_except_space(up_to_space); //Now, the padding will succeed
+        // back to ABCD / EFGH
+        tmp  = _mm_shuffle_epi32( abef, 0x1b);                                              // FEBA
+        cdgh = _mm_shuffle_epi32( cdgh, 0xb1);                                              // DCHG
+        _mm_storeu_si128( (__m128i*)&p_hs32[0], _mm_blend_epi16( tmp, cdgh, 0xf0));         // DCBA
+        _mm_storeu_si128( (__m128i*)&p_hs32[4], _mm_alignr_epi8( cdgh, tmp, 8));            // HGFE
+    }
+
+    // blocks of zeros on the SHA extensions, the round constants are all of the message
+    TARGET_ISA( "sha,sse4.1,ssse3") static void
+    process_zero_blocks_sha_ni( u32 (&p_hs32)[8], u64 p_blocks) noexcept {
+        __m128i tmp   = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*)&p_hs32[0]), 0xb1); // CDAB
+        __m128i cdgh  = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*)&p_hs32[4]), 0x1b); // EFGH
+        __m128i abef  = _mm_alignr_epi8( tmp, cdgh, 8);
+        cdgh          = _mm_blend_epi16( cdgh, tmp, 0xf0);
+
+        for (; p_blocks > 0; p_blocks--) {
+            const __m128i abef_save = abef, cdgh_save = cdgh;
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 16
+#endif
+            for (u8 q = 0; q < 16; q++) {
+                const __m128i wk = _mm_loadu_si128( (const __m128i*)&k[4 * q]);
+                cdgh = _mm_sha256rnds2_epu32( cdgh, abef, wk);
+                abef = _mm_sha256rnds2_epu32( abef, cdgh, _mm_shuffle_epi32( wk, 0x0e));
+            }
+            abef = _mm_add_epi32( abef, abef_save);
+            cdgh = _mm_add_epi32( cdgh, cdgh_save);
         }
+        tmp  = _mm_shuffle_epi32( abef, 0x1b);                                              // FEBA
+        cdgh = _mm_shuffle_epi32( cdgh, 0xb1);                                              // DCHG
+        _mm_storeu_si128( (__m128i*)&p_hs32[0], _mm_blend_epi16( tmp, cdgh, 0xf0));         // DCBA
+        _mm_storeu_si128( (__m128i*)&p_hs32[4], _mm_alignr_epi8( cdgh, tmp, 8));            // HGFE
     }
-    
+#endif
+
+    static inline bool s_sha_ni = CpuFeatures::get().sha_ni;  // the kernel of process_blocks, unless set
+    static bool use_sha_ni() noexcept { return s_sha_ni; }
+
+    constexpr void
+    process_blocks(const u8* p_data, const u64 p_blocks) noexcept {
+#if ISA_X86
+        if (!__builtin_is_constant_evaluated() && use_sha_ni())
+            return process_blocks_sha_ni( hs32, p_data, p_blocks);
+#endif
+        process_blocks_scalar( hs32, p_data, p_blocks);
+    }
+
+    void
+    process_zero_blocks(const u64 p_blocks) noexcept {
+#if ISA_X86
+        if (use_sha_ni())
+            return process_zero_blocks_sha_ni( hs32, p_blocks);
+#endif
+        process_zero_blocks_scalar( hs32, p_blocks);
+    }
+
     constexpr void finalize() {
         if (!finished) {
-            //6.2.1 SHA-256 Preprocessing 2.
-            const u64 conten_bit_len = payloadLen() * 8;
-            add_byte(0x80);
-            //5.1.2 Padding the Message
-            padding_the_message_except_space(sizeof(conten_bit_len));
-
-            for (auto b : ByteArrayOfScalar< u64, Endianes::Big>(conten_bit_len))
-                add_byte(b); // will reaching full buffer and get processed
+            //6.2.1 SHA-256 Preprocessing 2., 5.1.1 Padding the Message
+            pad();
 
             m_hash.reset();
             for (const u32 st : hs32)
@@ -117,14 +224,21 @@ private:
 
 public:
     constexpr Sha256()  noexcept { reset(); }
- 
-    constexpr const u64 payloadLen() const { return contendlen + buffer_filled; }
-    
+
+    /* description:    hashes by the SHA extensions if p_sha_ni, else by the portable code; to test and time each
+                       kernel, set while nothing is hashed
+       return value:   false, if the processor has not got the SHA extensions                                       */
+    static bool setShaNi(const bool p_sha_ni) noexcept {
+        if (p_sha_ni && !CpuFeatures::get().sha_ni)
+            return false;
+        s_sha_ni = p_sha_ni;
+        return true;
+    }
+
     constexpr Sha256&
     reset() noexcept {
         finished = false;
-        contendlen = 0;
-        buffer_filled = 0;
+        clear();
         m_hash.reset();
         //6.2.1, 5.3.3 SHA-256 Preprocessing 1.
         cpyArray( hs32init, hs32);
@@ -135,37 +249,31 @@ public:
     add_byte(const u8 b) {
         if (finished)
             reset();
-        //6.2.2 SHA-256 Hash Computation => 1. Prepare the message schedule
-        payload_buffer_as32bit[buffer_filled / 4].setByte(b, buffer_filled % 4);
-        if (++buffer_filled < size_payload_buffer_as08bit)
-            return;
-        //6.2.2 SHA-256 Hash Computation, if block is full
-        process_buffer();
-        contendlen += size_payload_buffer_as08bit;
+        ShaBlocks::add_byte( b);
+    }
+
+    /* description:    adds p_len bytes of the message; whole blocks are hashed in place, only the tail is kept        */
+    constexpr Sha256&
+    update(const u8* p_data, u64 p_len) noexcept {
+        if (finished)
+            reset();
+        append( p_data, p_len);
+        return *this;
+    }
+
+    /* description:    adds p_len zero bytes, as update() of as many zeros; the whole blocks without a message to
+                       read, the holes of sparse files                                                             */
+    Sha256&
+    updateZeros(u64 p_len) noexcept {
+        if (finished)
+            reset();
+        appendZeros( p_len);
+        return *this;
     }
 
     constexpr inline void
     add_block(const ArraySpan<u8> &p_a_08b) {
-        if ( finished)
-            reset();
-        //6.2.2 SHA-256 Hash Computation => 1. Prepare the message schedule
-        // check fast block condition
-        if ( buffer_filled == 0 && p_a_08b.count() == size_payload_buffer_as08bit)
-        {
-            for (BytesOfScalar< u32, Endianes::Big> &a_32b : payload_buffer_as32bit) {
-                a_32b.setByte( p_a_08b[ buffer_filled++], 0);
-                a_32b.setByte( p_a_08b[ buffer_filled++], 1);
-                a_32b.setByte( p_a_08b[ buffer_filled++], 2);
-                a_32b.setByte( p_a_08b[ buffer_filled++], 3);
-            }
-            //6.2.2 SHA-256 Hash Computation, if block is full
-            process_buffer();
-            contendlen += size_payload_buffer_as08bit;
-        }
-        else { // slow procedure, if it is not in block condition
-            for (const u8 b08b : p_a_08b)
-                add_byte( b08b);
-        }
+        update( p_a_08b.begin(), p_a_08b.count());
     }
 
     constexpr ArraySpan<u8> hash() {
@@ -0,0 +1,207 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements, alternativ for windows to                   *
+ *   using c++ ISO/IEC 14882:2011, Reference: https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf                    *
+ *                                                                                                                          *
+ *   Multi-buffer SHA-256: independent messages are hashed side by side, one message per SIMD lane. Every lane runs its   *
+ *   own message schedule and padding; a lane whose message is done is refilled with the next message of the batch.       *
+ *                                                                                                                          *
+ ****************************************************************************************************************************///
+
+#ifndef sha256mb_h
+#define sha256mb_h
+
+#include <string.h>
+#include "sha256.hpp"
+
+VERSION(sha256mb_hpp, 0, 1, 0, 0);
+
+// SIMD lanes are written with the vector extensions of gcc / clang, compiled per function by TARGET_ISA
+#if ISA_X86 && defined __GNUC__
+    #define SHA256_MULTI_BUFFER true
+    // vectors are passed by value only between always inlined functions, their ABI does not matter; the templates are
+    // instantiated at the end of the translation unit, so this can not be scoped by push / pop
+    #pragma GCC diagnostic ignored "-Wpsabi"
+#else
+    #define SHA256_MULTI_BUFFER false
+#endif
+
+/* one message of a batch, held completely in memory                                                                  */
+struct Sha256Message {
+    const u8* data = nullptr;
+    u64 len = 0;
+    u8 hash[32] = { 0 };
+    constexpr ArraySpan<u8> digest()                           noexcept { return ArraySpan<u8>({ &hash[0], &hash[32] }); }
+};
+
+class Sha256MultiBuffer : Static {
+    static constexpr u8 cBlockSize = Sha256::size_payload_buffer_as08bit;
+
+    static void hash_one_by_one( Sha256Message* p_msgs, const u64 p_count) noexcept {
+        Sha256 sha;
+        for (Sha256Message* m = p_msgs; m < p_msgs + p_count; m++) {
+            sha.reset().update( m->data, m->len);
+            u8 i = 0;
+            for (const u8 b : sha.hash())
+                m->hash[i++] = b;
+        }
+    }
+
+#if SHA256_MULTI_BUFFER
+    typedef u32 v8x32  __attribute__(( vector_size( 32)));
+    typedef u32 v16x32 __attribute__(( vector_size( 64)));
+
+    template <typename V> static inline __attribute__(( always_inline)) V
+    rot_r( const V a, const u8 b)                                          noexcept { return (a >> b) | (a << (32 - b)); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    ch(    const V x, const V y, const V z)                                noexcept { return (x &  y) ^ (~x &  z); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    maj(   const V x, const V y, const V z)                                noexcept { return (x &  y) ^ (x &  z) ^ (y & z); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    ep0(   const V x)                                                      noexcept { return (rot_r(x, 2) ^ rot_r(x, 13) ^ rot_r(x, 22)); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    ep1(   const V x)                                                      noexcept { return (rot_r(x, 6) ^ rot_r(x, 11) ^ rot_r(x, 25)); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    sig0(  const V x)                                                      noexcept { return (rot_r(x, 7) ^ rot_r(x, 18) ^ ((x) >> 3)); }
+    template <typename V> static inline __attribute__(( always_inline)) V
+    sig1(  const V x)                                                      noexcept { return (rot_r(x, 17) ^ rot_r(x, 19) ^ ((x) >> 10)); }
+
+    // 6.2.2 SHA-256 Hash Computation, every lane of V is an independent hash; inlined into the TARGET_ISA entry points
+    template <typename V> static inline __attribute__(( always_inline)) void
+    process_block( V (&p_hs)[8], const V (&p_w)[16]) noexcept {
+        V w[16];
+        for (u8 i = 0; i < 16; i++)
+            w[i] = p_w[i];
+        V a = p_hs[0], b = p_hs[1], c = p_hs[2], d = p_hs[3], e = p_hs[4], f = p_hs[5], g = p_hs[6], h = p_hs[7];
+        #pragma GCC unroll 64
+        for (u8 i = 0; i < 64; ++i) {
+            if (i >= 16) // message schedule rolling over 16 words
+                w[i & 15] += sig1(w[(i - 2) & 15]) + w[(i - 7) & 15] + sig0(w[(i - 15) & 15]);
+            const V t1 = h + ep1(e) + ch(e, f, g) + Sha256::k[i] + w[i & 15];
+            const V t2 = ep0(a) + maj(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        p_hs[0] += a; p_hs[1] += b; p_hs[2] += c; p_hs[3] += d; p_hs[4] += e; p_hs[5] += f; p_hs[6] += g; p_hs[7] += h;
+    }
+
+    TARGET_ISA( "avx2") static void
+    process_block_avx2( v8x32 (&p_hs)[8], const v8x32 (&p_w)[16])         noexcept { process_block( p_hs, p_w); }
+    TARGET_ISA( "avx512f") static void
+    process_block_avx512( v16x32 (&p_hs)[8], const v16x32 (&p_w)[16])     noexcept { process_block( p_hs, p_w); }
+
+    // 5.2.1 Parsing the Message into lane p_lane of the words p_w, 5.1.1 padding within the last one or two blocks
+    template <typename V> static void
+    load_block( V (&p_w)[16], const u8 p_lane, const Sha256Message &p_m, const u64 p_block, const u64 p_blocks) noexcept {
+        const u64 offset = p_block * cBlockSize;
+        const u8* src = p_m.data + offset;
+        u8 tail[cBlockSize];
+        if (offset + cBlockSize > p_m.len) {
+            memset( tail, 0, sizeof( tail));
+            if (offset <= p_m.len) {
+                memcpy( tail, src, p_m.len - offset);
+                tail[p_m.len - offset] = 0x80;
+            }
+            if (p_block + 1 == p_blocks) {
+                const u64 content_bit_len = p_m.len * 8;
+                for (u8 i = 0; i < 8; i++)
+                    tail[cBlockSize - 8 + i] = (u8)(content_bit_len >> (56 - 8 * i));
+            }
+            src = tail;
+        }
+        for (u8 t = 0; t < 16; t++, src += 4)
+            p_w[t][p_lane] = ((u32)src[0] << 24) | ((u32)src[1] << 16) | ((u32)src[2] << 8) | src[3];
+    }
+
+    template <typename V, u8 LANES, void (*PROCESS)( V (&)[8], const V (&)[16])> static void
+    hash_lanes( Sha256Message* p_msgs, const u64 p_count) noexcept {
+        V hs[8], w[16];
+        Sha256Message* lane_msg[LANES] = { nullptr };
+        u64 lane_block[LANES]  = { 0 };
+        u64 lane_blocks[LANES] = { 0 };
+        u64 next = 0;
+        u8 active = 0;
+
+        auto refill = [&]( const u8 l) {
+            lane_msg[l] = next < p_count ? &p_msgs[next++] : nullptr;
+            if (lane_msg[l] == nullptr)
+                return;
+            active++;
+            lane_block[l]  = 0;
+            lane_blocks[l] = (lane_msg[l]->len + 8) / cBlockSize + 1;  // content, 0x80 and the 64 bit length
+            for (u8 i = 0; i < 8; i++)
+                hs[i][l] = Sha256::hs32init[i];
+        };
+        for (u8 l = 0; l < LANES; l++)
+            refill( l);
+
+        while (active > 0) {
+            for (u8 l = 0; l < LANES; l++)
+                if (lane_msg[l])
+                    load_block( w, l, *lane_msg[l], lane_block[l], lane_blocks[l]);
+            PROCESS( hs, w);  // idle lanes compute garbage, nobody reads it
+            for (u8 l = 0; l < LANES; l++) {
+                if (lane_msg[l] == nullptr || ++lane_block[l] < lane_blocks[l])
+                    continue;
+                for (u8 i = 0; i < 8; i++)
+                    for (u8 j = 0; j < 4; j++)
+                        lane_msg[l]->hash[4 * i + j] = (u8)(hs[i][l] >> (24 - 8 * j));
+                active--;
+                refill( l);
+            }
+        }
+    }
+#endif
+
+#if SHA256_MULTI_BUFFER
+    static inline u8 s_lanes = CpuFeatures::get().avx512 ? 16 : CpuFeatures::get().avx2 && !CpuFeatures::get().sha_ni ? 8 : 1;
+#endif
+
+public:
+    // count of messages hashed side by side: 16 with AVX-512, 8 with AVX2 unless SHA-NI hashes faster one by one
+    static u8 lanes() noexcept {
+#if SHA256_MULTI_BUFFER
+        return s_lanes;
+#else
+        return 1;
+#endif
+    }
+
+    /* description:    hashes p_lanes messages side by side, 1 one by one by Sha256; to test and time each kernel,
+                       set while nothing is hashed
+       return value:   false, if the processor has not got the kernel of 8 or 16 lanes                              */
+    static bool setLanes(const u8 p_lanes) noexcept {
+#if SHA256_MULTI_BUFFER
+        if (p_lanes != 1 && !(p_lanes == 8 && CpuFeatures::get().avx2) && !(p_lanes == 16 && CpuFeatures::get().avx512))
+            return false;
+        s_lanes = p_lanes;
+        return true;
+#else
+        return p_lanes == 1;
+#endif
+    }
+
+    static void hash( Sha256Message* p_msgs, const u64 p_count) noexcept {
+        switch (lanes()) {
+#if SHA256_MULTI_BUFFER
+        case 16: hash_lanes< v16x32, 16, process_block_avx512>( p_msgs, p_count); break;
+        case 8:  hash_lanes< v8x32,   8, process_block_avx2  >( p_msgs, p_count); break;
+#endif
+        default: hash_one_by_one( p_msgs, p_count); break;
+        }
+    }
+};
+
+#endif /* sha256mb_h */
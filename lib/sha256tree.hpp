@@ -0,0 +1,156 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Tree hash of a file: the file is split into chunks of a fixed size, hashed side by side on threads. The leaves are    *
+ *   the plain SHA-256 of the chunks, so a single range can be checked on its own. Inner nodes are                          *
+ *   SHA-256( 0x01 | left | right), paired level by level, an odd last node moves up unchanged (the shape of RFC 6962).    *
+ *   The root of two leaves or more is an inner node, never the SHA-256 of the content.                                    *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef sha256tree_hpp
+#define sha256tree_hpp
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "base.hpp"
+#include "sha256.hpp"
+#include "io.hpp"
+
+VERSION( sha256tree_hpp, 0, 1, 0, 0);
+
+class Sha256Tree : Static {
+public:
+    static constexpr u64 cChunkSizeMin     = 1024 * 1024;
+    static constexpr u64 cChunkSizeMax     = 1024 * 1024 * 1024;
+    static constexpr u64 cChunkSizeDefault = 4 * 1024 * 1024;
+    static constexpr u8  cNodePrefix       = 0x01;
+
+    struct Leaf {
+        u64 len = 0;
+        u8 hash[32] = { 0 };
+        constexpr ArraySpan<u8> digest()                           noexcept { return ArraySpan<u8>({ &hash[0], &hash[32] }); }
+    };
+
+private:
+    static inline u64 s_chunk_size = 0;
+    static inline std::atomic<u32> s_helpers { 0 };  // helper threads running, of all files together
+
+    static void copyHash(u8 (&p_dest)[32], Sha256 &p_sha) noexcept {
+        u8 i = 0;
+        for (const u8 b : p_sha.hash())
+            p_dest[i++] = b;
+    }
+
+    // a thread per processor at most hashes chunks besides the threads calling hash()
+    static u32 helpersMax() noexcept {
+        static const u32 helpers = max<u32>( std::thread::hardware_concurrency(), 1) - 1;
+        return helpers;
+    }
+    // p_wanted helpers at most, of the ones not running; 0 if all are
+    static u32 takeHelpers(const u32 p_wanted) noexcept {
+        u32 running = s_helpers.load();
+        u32 taken = 0;
+        do
+            taken = running < helpersMax() ? min<u32>( p_wanted, helpersMax() - running) : 0;
+        while ( taken > 0 && !s_helpers.compare_exchange_weak( running, running + taken));
+        return taken;
+    }
+
+    // chunks p_next.. are taken one by one, till p_count, read and hashed a buffer of the readers at a time;
+    // p_error takes the first errno
+    static void hashChunks(const int p_fd, Leaf* p_leaves, const u64 p_count, std::atomic<u64> &p_next, std::atomic<int> &p_error) {
+        const u64 buffer_size = FileReader::bufferSize();
+        u8* const buffer = FileReader::allocateBuffer( buffer_size);
+        Sha256 sha;
+        for (u64 chunk = p_next++; chunk < p_count && p_error == 0; chunk = p_next++) {
+            sha.reset();
+            u64 len = 0;
+            while (len < s_chunk_size) {
+                u64 start = Stats::start();
+                const auto readen = pread( p_fd, buffer, min( buffer_size, s_chunk_size - len), chunk * s_chunk_size + len);
+                Stats::stop( Stats::cRead, start, readen > 0 ? readen : 0);
+                Throttle::read( readen > 0 ? readen : 0);
+                if ( readen < 0 && errno == EINTR)
+                    continue;
+                if ( readen < 0)
+                    p_error = errno;
+                if ( readen <= 0)
+                    break;
+                start = Stats::start();
+                sha.update( buffer, readen);
+                Stats::stop( Stats::cHash, start, readen);
+                len += readen;
+            }
+            p_leaves[chunk].len = len;
+            copyHash( p_leaves[chunk].hash, sha);
+        }
+        FileReader::freeBuffer( buffer);
+    }
+public:
+    /* description:    files of more than p_size bytes are tree hashed in chunks of p_size, 0 hashes none          */
+    static void setChunkSize(const u64 p_size) noexcept {
+        s_chunk_size = p_size == 0 ? 0 : max( cChunkSizeMin, min( cChunkSizeMax, p_size));
+    }
+    static u64  chunkSize()                     noexcept { return s_chunk_size; }
+    static bool wanted(const u64 p_size)        noexcept { return s_chunk_size > 0 && p_size > s_chunk_size; }
+    static u64  chunks(const u64 p_size)        noexcept { return (p_size + s_chunk_size - 1) / s_chunk_size; }
+
+    /* description:    hashes the first p_size bytes of the descriptor into p_leaves, chunks( p_size) of them, by the
+                       calling thread and the helper threads free. The helpers are shared by the files hashed at the
+                       same time, a thread per processor at most in all
+       return value:   errno of the first read failing, 0 if none. A file shrunk meanwhile has short leaves        */
+    static int hash(const int p_fd, const u64 p_size, Leaf* p_leaves) {
+        const u64 count = chunks( p_size);
+        std::atomic<u64> next { 0 };
+        std::atomic<int> error { 0 };
+        const u32 helpers = takeHelpers( (u32)min<u64>( count > 1 ? count - 1 : 0, helpersMax()));
+        std::thread* threads = new std::thread[helpers];
+        for (u32 i = 0; i < helpers; i++)
+            threads[i] = std::thread( [&]() { hashChunks( p_fd, p_leaves, count, next, error); });
+        hashChunks( p_fd, p_leaves, count, next, error);
+        for (u32 i = 0; i < helpers; i++)
+            threads[i].join();
+        delete[] threads;
+        s_helpers -= helpers;
+        return error;
+    }
+
+    /* description:    the Merkle root over p_count leaves, 1 at least                                              */
+    static void root(const Leaf* p_leaves, const u64 p_count, u8 (&p_root)[32]) {
+        u8 (*level)[32] = new u8[p_count][32];
+        for (u64 i = 0; i < p_count; i++)
+            memcpy( level[i], p_leaves[i].hash, 32);
+        Sha256 sha;
+        for (u64 count = p_count; count > 1; count = (count + 1) / 2) {
+            for (u64 i = 0; i + 1 < count; i += 2) {
+                sha.reset() << cNodePrefix;
+                sha.update( level[i], 32).update( level[i + 1], 32);
+                copyHash( level[i / 2], sha);
+            }
+            if ( count & 1)
+                memcpy( level[count / 2], level[count - 1], 32);
+        }
+        memcpy( p_root, level[0], 32);
+        delete[] level;
+    }
+};
+
+#endif
+#endif /* sha256tree_hpp */
@@ -0,0 +1,201 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements, alternativ for windows to                   *
+ *   using c++ ISO/IEC 14882:2011, Reference: https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf                    *
+ *   SHA-512 and SHA-512/256, its digest truncated to 256 bit with an initial hash value of its own: blocks of 128 bytes   *
+ *   in 64 bit words, on 64 bit processors without the SHA extensions faster per byte than Sha256. Same interface as it.   *
+ *                                                                                                                          *
+ ****************************************************************************************************************************///
+
+#ifndef sha512_h
+#define sha512_h
+
+#include <string.h>
+#include "base.hpp"
+#include "shablocks.hpp"
+
+VERSION(sha512_hpp, 0, 1, 0, 0);
+
+/* SHA-512 of DIGEST_SIZE 64, SHA-512/256 of DIGEST_SIZE 32: the same computation, the initial hash value differs
+   and the digest is the leading DIGEST_SIZE bytes of the hash value                                                  */
+template <u8 DIGEST_SIZE>
+class Sha512Family : public ShaBlocks< Sha512Family<DIGEST_SIZE>, u64, 128> {
+    static_assert( DIGEST_SIZE == 64 || DIGEST_SIZE == 32, "SHA-512 or SHA-512/256");
+    typedef ShaBlocks< Sha512Family<DIGEST_SIZE>, u64, 128> Blocks;
+    friend Blocks;
+private:
+    bool finished = false;
+    u64 hs64[8] = { 0 };
+    static constexpr u8 size_payload_buffer_as64bit = 16;
+public:
+    using Blocks::size_payload_buffer_as08bit;
+    static constexpr const char* cName = DIGEST_SIZE == 64 ? "sha512" : "sha512-256";
+private:
+    DArrayContainer< u8, DIGEST_SIZE> m_hash;
+
+    typedef const u64 u64c;
+
+    // 5.3.5 SHA-512, 5.3.6.2 SHA-512/256
+    constexpr static u64c hs64init[2][8] = {
+        { 0x6a09e667f3bcc908ull,0xbb67ae8584caa73bull,0x3c6ef372fe94f82bull,0xa54ff53a5f1d36f1ull,
+          0x510e527fade682d1ull,0x9b05688c2b3e6c1full,0x1f83d9abfb41bd6bull,0x5be0cd19137e2179ull },
+        { 0x22312194fc2bf72cull,0x9f555fa3c84c64c2ull,0x2393b86b6f53b151ull,0x963877195940eabdull,
+          0x96283ee2a88effe3ull,0xbe5e1e2553863992ull,0x2b0199fc2c85b8aaull,0x0eb72ddc81c52ca2ull } };
+
+    constexpr static u64c k[] = {
+        0x428a2f98d728ae22ull,0x7137449123ef65cdull,0xb5c0fbcfec4d3b2full,0xe9b5dba58189dbbcull,
+        0x3956c25bf348b538ull,0x59f111f1b605d019ull,0x923f82a4af194f9bull,0xab1c5ed5da6d8118ull,
+        0xd807aa98a3030242ull,0x12835b0145706fbeull,0x243185be4ee4b28cull,0x550c7dc3d5ffb4e2ull,
+        0x72be5d74f27b896full,0x80deb1fe3b1696b1ull,0x9bdc06a725c71235ull,0xc19bf174cf692694ull,
+        0xe49b69c19ef14ad2ull,0xefbe4786384f25e3ull,0x0fc19dc68b8cd5b5ull,0x240ca1cc77ac9c65ull,
+        0x2de92c6f592b0275ull,0x4a7484aa6ea6e483ull,0x5cb0a9dcbd41fbd4ull,0x76f988da831153b5ull,
+        0x983e5152ee66dfabull,0xa831c66d2db43210ull,0xb00327c898fb213full,0xbf597fc7beef0ee4ull,
+        0xc6e00bf33da88fc2ull,0xd5a79147930aa725ull,0x06ca6351e003826full,0x142929670a0e6e70ull,
+        0x27b70a8546d22ffcull,0x2e1b21385c26c926ull,0x4d2c6dfc5ac42aedull,0x53380d139d95b3dfull,
+        0x650a73548baf63deull,0x766a0abb3c77b2a8ull,0x81c2c92e47edaee6ull,0x92722c851482353bull,
+        0xa2bfe8a14cf10364ull,0xa81a664bbc423001ull,0xc24b8b70d0f89791ull,0xc76c51a30654be30ull,
+        0xd192e819d6ef5218ull,0xd69906245565a910ull,0xf40e35855771202aull,0x106aa07032bbd1b8ull,
+        0x19a4c116b8d2d0c8ull,0x1e376c085141ab53ull,0x2748774cdf8eeb99ull,0x34b0bcb5e19b48a8ull,
+        0x391c0cb3c5c95a63ull,0x4ed8aa4ae3418acbull,0x5b9cca4f7763e373ull,0x682e6ff3d6b2b8a3ull,
+        0x748f82ee5defb2fcull,0x78a5636f43172f60ull,0x84c87814a1f0ab72ull,0x8cc702081a6439ecull,
+        0x90befffa23631e28ull,0xa4506cebde82bde9ull,0xbef9a3f7b2c67915ull,0xc67178f2e372532bull,
+        0xca273eceea26619cull,0xd186b8c721c0c207ull,0xeada7dd6cde0eb1eull,0xf57d4f7fee6ed178ull,
+        0x06f067aa72176fbaull,0x0a637dc5a2c898a6ull,0x113f9804bef90daeull,0x1b710b35131c471bull,
+        0x28db77f523047d84ull,0x32caab7b40c72493ull,0x3c9ebe0a15c9bebcull,0x431d67c49c100d4cull,
+        0x4cc5d4becb3e42b6ull,0x597f299cfc657e2aull,0x5fcb6fab3ad6faecull,0x6c44198c4a475817ull
+    };
+
+    static constexpr u64  rot_r(const u64c a, const u32 b)                noexcept { return (a >> b) | (a << (64 - b)); }
+    static constexpr u64  ch(   const u64c x, const u64c y, const u64c z) noexcept { return z ^ (x & (y ^ z)); }
+    static constexpr u64  maj(  const u64c x, const u64c y, const u64c z) noexcept { return (x & y) | (z & (x | y)); }
+    static constexpr u64  ep0(  const u64c x)                             noexcept { return (rot_r(x, 28) ^ rot_r(x, 34) ^ rot_r(x, 39)); }
+    static constexpr u64  ep1(  const u64c x)                             noexcept { return (rot_r(x, 14) ^ rot_r(x, 18) ^ rot_r(x, 41)); }
+    static constexpr u64  sig0( const u64c x)                             noexcept { return (rot_r(x, 1) ^ rot_r(x, 8) ^ ((x) >> 7)); }
+    static constexpr u64  sig1( const u64c x)                             noexcept { return (rot_r(x, 19) ^ rot_r(x, 61) ^ ((x) >> 6)); }
+
+    // 5.2.2 Parsing the Message, words are big endian
+    static u64  load_be64(const u8* p)                                    noexcept {
+        u64 v;
+        memcpy( &v, p, sizeof( v));
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return v;
+#else
+        return __builtin_bswap64( v);
+#endif
+    }
+
+    // 6.4.2 SHA-512 Hash Computation, straight from the message; the schedule rolls over 16 words instead of 80
+    static void
+    process_blocks_scalar( u64 (&p_hs64)[8], const u8* p_data, u64 p_blocks) noexcept {
+        for (; p_blocks > 0; p_blocks--, p_data += size_payload_buffer_as08bit) {
+            u64 w[size_payload_buffer_as64bit];
+            u64 a = p_hs64[0], b = p_hs64[1], c = p_hs64[2], d = p_hs64[3], e = p_hs64[4], f = p_hs64[5], g = p_hs64[6], h = p_hs64[7];
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 80
+#endif
+            for (u8 i = 0; i < 80; ++i) {
+                if (i < 16)
+                    w[i] = load_be64( p_data + 8 * i);
+                else
+                    w[i & 15] += sig1(w[(i - 2) & 15]) + w[(i - 7) & 15] + sig0(w[(i - 15) & 15]);
+                const u64 t1 = h + ep1(e) + ch(e, f, g) + k[i] + w[i & 15];
+                const u64 t2 = ep0(a) + maj(a, b, c);
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            p_hs64[0] += a; p_hs64[1] += b; p_hs64[2] += c; p_hs64[3] += d; p_hs64[4] += e; p_hs64[5] += f; p_hs64[6] += g; p_hs64[7] += h;
+        }
+    }
+
+    // blocks of zeros: the message schedule is zero all through, the rounds add the constants only
+    static void
+    process_zero_blocks_scalar( u64 (&p_hs64)[8], u64 p_blocks) noexcept {
+        for (; p_blocks > 0; p_blocks--) {
+            u64 a = p_hs64[0], b = p_hs64[1], c = p_hs64[2], d = p_hs64[3], e = p_hs64[4], f = p_hs64[5], g = p_hs64[6], h = p_hs64[7];
+#if defined __GNUC__ && !defined __clang__
+            #pragma GCC unroll 80
+#endif
+            for (u8 i = 0; i < 80; ++i) {
+                const u64 t1 = h + ep1(e) + ch(e, f, g) + k[i];
+                const u64 t2 = ep0(a) + maj(a, b, c);
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            p_hs64[0] += a; p_hs64[1] += b; p_hs64[2] += c; p_hs64[3] += d; p_hs64[4] += e; p_hs64[5] += f; p_hs64[6] += g; p_hs64[7] += h;
+        }
+    }
+
+    void process_blocks(const u8* p_data, const u64 p_blocks) noexcept { process_blocks_scalar( hs64, p_data, p_blocks); }
+    void process_zero_blocks(const u64 p_blocks)              noexcept { process_zero_blocks_scalar( hs64, p_blocks); }
+
+    void finalize() noexcept {
+        if (!finished) {
+            //6.4.1 SHA-512 Preprocessing 2., 5.1.2 Padding the Message
+            Blocks::pad();
+            m_hash.reset();
+            for (u8 i = 0; i < DIGEST_SIZE / 8; i++)
+                m_hash << ByteArrayOfScalar< u64, Endianes::Big>(hs64[i]);
+            finished = true;
+        }
+    }
+
+public:
+    Sha512Family()  noexcept { reset(); }
+
+    Sha512Family&
+    reset() noexcept {
+        finished = false;
+        Blocks::clear();
+        m_hash.reset();
+        //6.4.1, 5.3.5 SHA-512 Preprocessing 1.
+        cpyArray( hs64init[DIGEST_SIZE == 64 ? 0 : 1], hs64);
+        return *this;
+    }
+
+    /* description:    adds p_len bytes of the message; whole blocks are hashed in place, only the tail is kept        */
+    Sha512Family&
+    update(const u8* p_data, u64 p_len) noexcept {
+        if (finished)
+            reset();
+        Blocks::append( p_data, p_len);
+        return *this;
+    }
+
+    /* description:    adds p_len zero bytes, as update() of as many zeros; the whole blocks without a message to
+                       read, the holes of sparse files                                                             */
+    Sha512Family&
+    updateZeros(u64 p_len) noexcept {
+        if (finished)
+            reset();
+        Blocks::appendZeros( p_len);
+        return *this;
+    }
+
+    ArraySpan<u8> hash() noexcept {
+        finalize();
+        return m_hash.reader();
+    }
+};
+
+typedef Sha512Family<64> Sha512;
+typedef Sha512Family<32> Sha512_256;
+
+#endif /* sha512_h */
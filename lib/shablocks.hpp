@@ -0,0 +1,129 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements, alternativ for windows to                   *
+ *   using c++ ISO/IEC 14882:2011, Reference: https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf                    *
+ *   The message of SHA-256 and SHA-512 in blocks: the tail kept till a block is full, the padding of 5.1.                 *
+ *                                                                                                                          *
+ ****************************************************************************************************************************///
+
+#ifndef shablocks_h
+#define shablocks_h
+
+#include <string.h>
+#include "base.hpp"
+
+VERSION(shablocks_hpp, 0, 1, 0, 0);
+
+/* the message cut into blocks of BLOCK_SIZE bytes for HASHER, which derives from it and computes the hash of whole
+   blocks by process_blocks( p_data, p_blocks), of blocks of zeros by process_zero_blocks( p_blocks). The length of
+   the message is padded in as two WORDs, 64 bit for SHA-256, 128 bit for SHA-512                                     */
+template <typename HASHER, typename WORD, u8 BLOCK_SIZE>
+class ShaBlocks {
+protected:
+    static constexpr u8 cLengthSize = 2 * sizeof( WORD);
+
+    u8  buffer_filled = 0;
+    u64 contendlen = 0;
+    u8  buffer[ BLOCK_SIZE] = { 0 };                       // tail of the message, not yet a whole block
+
+    constexpr HASHER& hasher() noexcept { return static_cast<HASHER&>( *this); }
+
+    constexpr void clear() noexcept {
+        contendlen = 0;
+        buffer_filled = 0;
+    }
+
+    constexpr void
+    add_byte(const u8 b) noexcept {
+        buffer[ buffer_filled] = b;
+        if (++buffer_filled < BLOCK_SIZE)
+            return;
+        hasher().process_blocks( buffer, 1);
+        buffer_filled = 0;
+        contendlen += BLOCK_SIZE;
+    }
+
+    /* description:    adds p_len bytes of the message; whole blocks are hashed in place, only the tail is kept        */
+    constexpr void
+    append(const u8* p_data, u64 p_len) noexcept {
+        if (buffer_filled > 0) { // complete the pending block first
+            while (p_len > 0 && buffer_filled < BLOCK_SIZE) {
+                buffer[ buffer_filled++] = *p_data++;
+                p_len--;
+            }
+            if (buffer_filled < BLOCK_SIZE)
+                return;
+            hasher().process_blocks( buffer, 1);
+            buffer_filled = 0;
+            contendlen += BLOCK_SIZE;
+        }
+        const u64 blocks = p_len / BLOCK_SIZE;
+        if (blocks > 0) {
+            hasher().process_blocks( p_data, blocks);
+            contendlen += blocks * BLOCK_SIZE;
+            p_data     += blocks * BLOCK_SIZE;
+            p_len      -= blocks * BLOCK_SIZE;
+        }
+        while (p_len-- > 0)
+            buffer[ buffer_filled++] = *p_data++;
+    }
+
+    /* description:    adds p_len zero bytes, as append() of as many zeros; the whole blocks without a message to
+                       read, the holes of sparse files                                                             */
+    void
+    appendZeros(u64 p_len) noexcept {
+        if (buffer_filled > 0) {
+            const u64 n = min<u64>( p_len, BLOCK_SIZE - buffer_filled);
+            memset( buffer + buffer_filled, 0, n);
+            buffer_filled += n;
+            p_len -= n;
+            if (buffer_filled < BLOCK_SIZE)
+                return;
+            hasher().process_blocks( buffer, 1);
+            buffer_filled = 0;
+            contendlen += BLOCK_SIZE;
+        }
+        const u64 blocks = p_len / BLOCK_SIZE;
+        hasher().process_zero_blocks( blocks);
+        contendlen += blocks * BLOCK_SIZE;
+        p_len      -= blocks * BLOCK_SIZE;
+        memset( buffer, 0, p_len);
+        buffer_filled = p_len;
+    }
+
+    /* description:    5.1 Padding the Message: the bit 1, zeros and the length in bits, big endian, in the last
+                       cLengthSize bytes of a block; hashes the last block or two                                  */
+    constexpr void
+    pad() noexcept {
+        const u64 len = payloadLen();
+        const u64 conten_bit_len = len * 8;
+        buffer[ buffer_filled++] = 0x80;
+        if (buffer_filled > BLOCK_SIZE - cLengthSize) {
+            while (buffer_filled < BLOCK_SIZE)
+                buffer[ buffer_filled++] = 0;
+            hasher().process_blocks( buffer, 1);
+            buffer_filled = 0;
+        }
+        while (buffer_filled < BLOCK_SIZE - sizeof(conten_bit_len))
+            buffer[ buffer_filled++] = 0;
+        if (cLengthSize > sizeof(conten_bit_len))  // the upper 64 bit of the length of SHA-512
+            buffer[ buffer_filled - 1] = (u8)(len >> 61);
+        for (auto b : ByteArrayOfScalar< u64, Endianes::Big>(conten_bit_len))
+            buffer[ buffer_filled++] = b;
+        hasher().process_blocks( buffer, 1);
+        buffer_filled = 0;
+    }
+
+public:
+    static constexpr u8 size_payload_buffer_as08bit = BLOCK_SIZE;
+
+    constexpr u64 payloadLen() const noexcept { return contendlen + buffer_filled; }
+};
+
+#endif /* shablocks_h */
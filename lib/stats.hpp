@@ -0,0 +1,447 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Time spent per phase of the scan: stat, open of directories, reading them, open of files, reading, hashing,            *
+ *   the final block of the digest, output. Each thread counts in counters of its own, by a monotonic clock in              *
+ *   nanoseconds; the report sums them up, the seconds of a phase are those of all threads together. Files are counted      *
+ *   in histograms of their size and of their latency, from the walk handing them over till their digest. Off, nothing      *
+ *   is counted and the clock is never read. With a trace, each phase is an event as well, of the file if known, and        *
+ *   each file and directory walked; in a ring of the thread, written as Chrome trace JSON by a thread of its own. What     *
+ *   finds a ring full is dropped and counted.                                                                              *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef stats_hpp
+#define stats_hpp
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <new>
+#include "base.hpp"
+#ifndef _WIN32
+    #include <signal.h>
+    #include <pthread.h>
+#endif
+
+VERSION( stats_hpp, 0, 1, 0, 0);
+
+/* counts of a value by magnitude: 4 buckets per power of two, the first 4 exact                                      */
+struct Histogram {
+    static constexpr u32 cBuckets = 256;
+    std::atomic<u64> counts[cBuckets] = { };
+    std::atomic<u64> max { 0 };
+    std::atomic<u64> sum { 0 };
+
+    static u32 bucket(const u64 p_v) noexcept {
+        if ( p_v < 4)
+            return (u32)p_v;
+        const u32 bits = 63 - __builtin_clzll( p_v);
+        return (bits - 1) * 4 + (u32)((p_v >> (bits - 2)) & 3);
+    }
+    // the least value of the bucket
+    static u64 lower(const u32 p_bucket) noexcept {
+        return p_bucket < 4 ? p_bucket : (u64)(4 + p_bucket % 4) << (p_bucket / 4 - 1);
+    }
+    // by the thread owning it only, the report reads it meanwhile
+    void add(const u64 p_v) noexcept {
+        std::atomic<u64> &count = counts[bucket( p_v)];
+        count.store( count.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store( sum.load( std::memory_order_relaxed) + p_v, std::memory_order_relaxed);
+        if ( p_v > max.load( std::memory_order_relaxed))
+            max.store( p_v, std::memory_order_relaxed);
+    }
+};
+
+/* events of a thread for the trace, a ring of one writer, the thread, and one reader, the thread of the trace      */
+struct TraceEvent {
+    u64  start;   // ns
+    u64  duration;
+    u64  bytes;
+    u8   kind;    // Stats::Phase, or Stats::cFileSpan, cDirSpan
+    char name[63];
+};
+
+struct TraceRing : Independent {
+    static constexpr u64 cEvents = 16 * 1024;
+    TraceEvent events[cEvents];
+    std::atomic<u64> head { 0 };  // written next by the thread
+    std::atomic<u64> tail { 0 };  // read next by the thread of the trace
+    u64 dropped = 0;              // of a full ring, by the thread
+    TraceRing() noexcept { }
+
+    /* description:    appends the event, the tail of p_name, if it fits                                           */
+    void push(const u8 p_kind, const u64 p_start, const u64 p_end, const u64 p_bytes, const char* p_name) noexcept {
+        const u64 h = head.load( std::memory_order_relaxed);
+        if ( h - tail.load( std::memory_order_acquire) == cEvents) {
+            dropped++;
+            return;
+        }
+        TraceEvent &e = events[h % cEvents];
+        e.start    = p_start;
+        e.duration = p_end - p_start;
+        e.bytes    = p_bytes;
+        e.kind     = p_kind;
+        e.name[0] = 0;
+        if ( p_name != nullptr) {
+            const size_t len = strlen( p_name);
+            const size_t keep = min<size_t>( len, sizeof( e.name) - 1);
+            memcpy( e.name, p_name + len - keep, keep);
+            e.name[keep] = 0;
+        }
+        head.store( h + 1, std::memory_order_release);
+    }
+};
+
+class Stats : Static {
+public:
+    enum Phase : u32 { cStat, cOpenDir, cReadDir, cOpen, cRead, cHash, cFinal, cOutput, cPhases };
+    enum Span  : u32 { cFileSpan = cPhases, cDirSpan };
+
+    struct Counters : Independent {
+        std::atomic<u64> count[cPhases] = { };
+        std::atomic<u64> ns[cPhases] = { };
+        std::atomic<u64> bytes[cPhases] = { };
+        Histogram sizes;
+        Histogram latencies;
+        Counters* next = nullptr;
+        TraceRing* trace = nullptr;  // with a trace only
+        u32 thread = 0;              // the tid of the trace
+        Counters() noexcept { }
+
+        void add(const Phase p_phase, const u64 p_ns, const u64 p_bytes) noexcept {
+            count[p_phase].store( count[p_phase].load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            ns[p_phase].store( ns[p_phase].load( std::memory_order_relaxed) + p_ns, std::memory_order_relaxed);
+            bytes[p_phase].store( bytes[p_phase].load( std::memory_order_relaxed) + p_bytes, std::memory_order_relaxed);
+        }
+    };
+
+private:
+    static inline bool s_enabled = false;
+    static inline u64 s_start = 0;
+    static inline std::atomic<Counters*> s_all { nullptr };  // of all threads ever counting, kept till the exit
+    static inline std::atomic<u32> s_threads { 0 };
+    static inline thread_local Counters* t_counters = nullptr;
+#ifndef _WIN32
+    static inline std::thread s_listener;
+    static inline std::atomic<bool> s_stopping { false };
+    static inline int s_signal = 0;
+#endif
+    static inline FILE* s_trace = nullptr;
+    static inline std::thread s_tracer;
+    static inline std::atomic<bool> s_trace_stopping { false };
+    static inline bool s_trace_first = true;
+
+    // the counters of the calling thread, nullptr without memory: then it is not counted
+    static Counters* local() noexcept {
+        if ( t_counters == nullptr && (t_counters = new (std::nothrow) Counters()) != nullptr) {
+            t_counters->thread = ++s_threads;
+            if ( s_trace != nullptr)
+                t_counters->trace = new (std::nothrow) TraceRing();
+            t_counters->next = s_all.load();
+            while ( !s_all.compare_exchange_weak( t_counters->next, t_counters)) ;
+        }
+        return t_counters;
+    }
+
+    static constexpr const char* cPhaseNames[cPhases + 2] = { "stat", "opendir", "readdir", "open", "read", "hash", "finalize", "output", "file", "dir" };
+
+    // p_name as a JSON string, UTF-8 kept where it is valid, other bytes as '?'
+    static void putJsonString(FILE* p_out, const char* p_name) {
+        fputc( '"', p_out);
+        for (const u8* c = (const u8*)p_name; *c != 0; c++) {
+            u32 follow = *c >= 0xf0 && *c < 0xf5 ? 3 : *c >= 0xe0 ? 2 : *c >= 0xc2 ? 1 : 0;
+            if ( *c >= 0x80) {
+                bool valid = follow > 0;
+                for (u32 i = 1; valid && i <= follow; i++)
+                    valid = (c[i] & 0xc0) == 0x80;
+                if ( !valid) {
+                    fputc( '?', p_out);
+                    continue;
+                }
+                fwrite( c, 1, follow + 1, p_out);
+                c += follow;
+            }
+            else if ( *c == '"' || *c == '\\')
+                fprintf( p_out, "\\%c", *c);
+            else if ( *c < 0x20)
+                fprintf( p_out, "\\u%04x", *c);
+            else
+                fputc( *c, p_out);
+        }
+        fputc( '"', p_out);
+    }
+
+    // writes the events of all rings so far
+    static void drainTrace() {
+        for (Counters* c = s_all.load(); c != nullptr; c = c->next) {
+            TraceRing* ring = c->trace;
+            if ( ring == nullptr)
+                continue;
+            const u64 head = ring->head.load( std::memory_order_acquire);
+            u64 tail = ring->tail.load( std::memory_order_relaxed);
+            for (; tail < head; tail++) {
+                const TraceEvent &e = ring->events[tail % TraceRing::cEvents];
+                fputs( s_trace_first ? "\n" : ",\n", s_trace);
+                s_trace_first = false;
+                fprintf( s_trace, "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"cat\":\"%s\",\"name\":", c->thread,
+                    (e.start - s_start) / 1e3, e.duration / 1e3, cPhaseNames[e.kind]);
+                putJsonString( s_trace, e.kind >= cPhases ? e.name : cPhaseNames[e.kind]);
+                const bool file = e.kind < cPhases && e.name[0] != 0;  // the file of a phase
+                if ( e.bytes > 0 || file)
+                    fputs( ",\"args\":{", s_trace);
+                if ( e.bytes > 0)
+                    fprintf( s_trace, "\"bytes\":%llu%s", (unsigned long long)e.bytes, file ? "," : "");
+                if ( file) {
+                    fputs( "\"file\":", s_trace);
+                    putJsonString( s_trace, e.name);
+                }
+                if ( e.bytes > 0 || file)
+                    fputc( '}', s_trace);
+                fputc( '}', s_trace);
+            }
+            ring->tail.store( tail, std::memory_order_release);
+        }
+    }
+
+    // p_bytes with a binary unit
+    static const char* size(char (&p_text)[16], const u64 p_bytes) noexcept {
+        const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB" };
+        u32 unit = 0;
+        for (u64 v = p_bytes; v >= 1024 && v % 1024 == 0; v /= 1024)
+            unit++;
+        snprintf( p_text, sizeof( p_text), "%llu %s", (unsigned long long)(p_bytes >> (10 * unit)), units[unit]);
+        return p_text;
+    }
+
+    // the least value, p_fraction of the counts are not above; a bound of its bucket
+    static u64 quantile(const u64 (&p_counts)[Histogram::cBuckets], const u64 p_total, const double p_fraction, const u64 p_max) noexcept {
+        const u64 rank = max<u64>( (u64)(p_fraction * p_total + 0.999999), 1);
+        u64 seen = 0;
+        for (u32 i = 0; i < Histogram::cBuckets; i++)
+            if ( (seen += p_counts[i]) >= rank)
+                return min<u64>( i + 1 < Histogram::cBuckets ? Histogram::lower( i + 1) - 1 : p_max, p_max);
+        return p_max;
+    }
+
+public:
+    /* description:    counts from now on                                                                          */
+    static void enable() noexcept {
+        if ( !s_enabled)
+            s_start = now();
+        s_enabled = true;
+    }
+    static bool enabled() noexcept { return s_enabled; }
+
+    static u64 now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* description:    the start of a phase, by the clock if counting
+       return value:   the time, 0 if not counting                                                                 */
+    static u64 start() noexcept { return s_enabled ? now() : 0; }
+
+    /* description:    counts the phase started at p_start, with p_bytes, unless p_start is 0; an event of the
+                       trace, if tracing, of the file p_name if known
+       return value:   none                                                                                        */
+    static void stop(const Phase p_phase, const u64 p_start, const u64 p_bytes = 0, const char* p_name = nullptr) noexcept {
+        Counters* counters;
+        if ( p_start == 0 || (counters = local()) == nullptr)
+            return;
+        const u64 end = now();
+        counters->add( p_phase, end - p_start, p_bytes);
+        if ( counters->trace != nullptr)
+            counters->trace->push( p_phase, p_start, end, p_bytes, p_name);
+    }
+    /* description:    an event of the trace from p_start till now, named by the tail of p_name, as a Scope of a
+                       file handed over to other threads or batched, by the start it carries
+       return value:   none                                                                                        */
+    static void span(const Span p_span, const u64 p_start, const char* p_name) noexcept {
+        Counters* counters;
+        if ( p_start != 0 && s_trace != nullptr && (counters = local()) != nullptr && counters->trace != nullptr)
+            counters->trace->push( p_span, p_start, now(), 0, p_name);
+    }
+    /* description:    counts p_bytes for the phase without a time, as done by the kernel asynchronously           */
+    static void count(const Phase p_phase, const u64 p_bytes) noexcept {
+        Counters* counters;
+        if ( s_enabled && (counters = local()) != nullptr)
+            counters->add( p_phase, 0, p_bytes);
+    }
+
+    /* description:    counts a file of p_size bytes, handed over at p_start, done now
+       return value:   none                                                                                        */
+    static void file(const u64 p_size, const u64 p_start) noexcept {
+        Counters* counters;
+        if ( p_start == 0 || (counters = local()) == nullptr)
+            return;
+        counters->sizes.add( p_size);
+        counters->latencies.add( now() - p_start);
+    }
+
+    /* description:    writes the report of the counts so far to p_out, in one write, the lines starting with *STATS*.
+                       May run while the threads count, the sums are consistent per counter only
+       return value:   none                                                                                        */
+    static void report(FILE* p_out) {
+        u64 count[cPhases] = { 0 }, ns[cPhases] = { 0 }, bytes[cPhases] = { 0 };
+        u64 sizes[Histogram::cBuckets] = { 0 }, latencies[Histogram::cBuckets] = { 0 };
+        u64 size_max = 0, latency_max = 0, files = 0, file_bytes = 0;
+        for (Counters* c = s_all.load(); c != nullptr; c = c->next) {
+            for (u32 p = 0; p < cPhases; p++) {
+                count[p] += c->count[p].load( std::memory_order_relaxed);
+                ns[p]    += c->ns[p].load( std::memory_order_relaxed);
+                bytes[p] += c->bytes[p].load( std::memory_order_relaxed);
+            }
+            for (u32 i = 0; i < Histogram::cBuckets; i++) {
+                sizes[i]     += c->sizes.counts[i].load( std::memory_order_relaxed);
+                latencies[i] += c->latencies.counts[i].load( std::memory_order_relaxed);
+            }
+            file_bytes += c->sizes.sum.load( std::memory_order_relaxed);
+            size_max    = max<u64>( size_max, c->sizes.max.load( std::memory_order_relaxed));
+            latency_max = max<u64>( latency_max, c->latencies.max.load( std::memory_order_relaxed));
+        }
+        for (u32 i = 0; i < Histogram::cBuckets; i++)
+            files += sizes[i];
+        const double seconds = (now() - s_start) / 1e9;
+
+        char text[8192];
+        u64 len = 0;
+        auto put = [&]( const char* p_format, auto... p_args) {
+            if ( len < sizeof( text))
+                len += snprintf( text + len, sizeof( text) - len, p_format, p_args...);
+        };
+        put( "*STATS* %.3f s: %llu files, %llu bytes hashed, %.0f files/s, %.1f MB/s\n", seconds, (unsigned long long)files,
+            (unsigned long long)file_bytes, seconds > 0 ? files / seconds : 0.0, seconds > 0 ? file_bytes / seconds / 1e6 : 0.0);
+        put( "*STATS* %-8s %12s %12s %12s %12s\n", "phase", "count", "seconds", "per s", "MB/s");
+        for (u32 p = 0; p < cPhases; p++) {
+            if ( count[p] == 0)
+                continue;
+            put( "*STATS* %-8s %12llu %12.3f", cPhaseNames[p], (unsigned long long)count[p], ns[p] / 1e9);
+            if ( ns[p] > 0)
+                put( " %12.0f", count[p] * 1e9 / ns[p]);
+            else
+                put( " %12s", "-");
+            if ( ns[p] > 0 && bytes[p] > 0)
+                put( " %12.1f\n", bytes[p] * 1e3 / ns[p]);
+            else
+                put( " %12s\n", bytes[p] > 0 ? "async" : "-");
+        }
+        if ( files > 0) {
+            put( "*STATS* latency  p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", quantile( latencies, files, 0.5, latency_max) / 1e6,
+                quantile( latencies, files, 0.99, latency_max) / 1e6, latency_max / 1e6);
+            put( "*STATS* size     p50 %llu, p99 %llu, max %llu bytes\n", (unsigned long long)quantile( sizes, files, 0.5, size_max),
+                (unsigned long long)quantile( sizes, files, 0.99, size_max), (unsigned long long)size_max);
+            // by powers of two
+            for (u32 first = 0; first < Histogram::cBuckets; ) {
+                const u32 last = first < 4 ? first + 1 : (first / 4 + 1) * 4;
+                u64 n = 0;
+                for (u32 i = first; i < last; i++)
+                    n += sizes[i];
+                if ( n > 0) {
+                    char low[16], high[16];
+                    put( "*STATS* size     %10s .. < %-10s %12llu\n", size( low, Histogram::lower( first)),
+                        size( high, last < Histogram::cBuckets ? Histogram::lower( last) : ~0ull), (unsigned long long)n);
+                }
+                first = last;
+            }
+        }
+        fwrite( text, 1, min<u64>( len, sizeof( text) - 1), p_out);
+        fflush( p_out);
+    }
+
+    /* description:    writes a trace of the events to the file p_path from now on, as Chrome trace JSON: each phase
+                       of each thread, each file and each directory of searchDir, by a thread of its own
+       error:          of fopen                                                                                    */
+    static void traceTo(const char* p_path) {
+        if ( (s_trace = fopen( p_path, "w")) == nullptr)
+            throw new _Exception( errno, p_path);
+        enable();
+        fputs( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", s_trace);
+        s_tracer = std::thread( []() {
+            while ( !s_trace_stopping) {
+                std::this_thread::sleep_for( std::chrono::milliseconds( 20));
+                drainTrace();
+            }
+        });
+    }
+    static bool tracing() noexcept { return s_trace != nullptr; }
+
+    /* description:    writes the rest of the events and the names of the threads, closes the trace
+       return value:   none                                                                                        */
+    static void stopTracing() {
+        if ( !s_tracer.joinable())
+            return;
+        s_trace_stopping = true;
+        s_tracer.join();
+        drainTrace();
+        u64 dropped = 0;
+        for (Counters* c = s_all.load(); c != nullptr; c = c->next) {
+            if ( c->trace != nullptr)
+                dropped += c->trace->dropped;
+            fprintf( s_trace, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %u\"}}",
+                s_trace_first ? "\n" : ",\n", c->thread, c->thread);
+            s_trace_first = false;
+        }
+        fprintf( s_trace, "\n],\"otherData\":{\"dropped\":%llu}}\n", (unsigned long long)dropped);
+        if ( dropped > 0)
+            fprintf( stderr, "trace: %llu events dropped, the rings of %llu events were full\n", (unsigned long long)dropped,
+                (unsigned long long)TraceRing::cEvents);
+        fclose( s_trace);
+        s_trace = nullptr;
+    }
+
+    /* an event of the trace from its construction till its destruction, named by the tail of p_name                 */
+    class Scope : Static {
+        const Span  m_span;
+        const char* m_name;
+        const u64   m_start;
+    public:
+        Scope(const Span p_span, const char* p_name) noexcept : m_span( p_span), m_name( p_name), m_start( s_trace != nullptr ? now() : 0) { }
+        ~Scope() {
+            Counters* counters;
+            if ( m_start != 0 && (counters = local()) != nullptr && counters->trace != nullptr)
+                counters->trace->push( m_span, m_start, now(), 0, m_name);
+        }
+    };
+
+#ifndef _WIN32
+    /* description:    reports to stderr on each p_signal, by a thread waiting for it. The signal is blocked in the
+                       calling thread and in the threads it starts later: call it ahead of those
+       return value:   none                                                                                        */
+    static void listen(const int p_signal) {
+        sigset_t set;
+        sigemptyset( &set);
+        sigaddset( &set, p_signal);
+        pthread_sigmask( SIG_BLOCK, &set, nullptr);
+        s_signal = p_signal;
+        s_listener = std::thread( [set]() {
+            int signal = 0;
+            while ( sigwait( &set, &signal) == 0 && !s_stopping)
+                report( stderr);
+        });
+    }
+    /* description:    stops the thread of listen()                                                                */
+    static void stopListening() {
+        if ( !s_listener.joinable())
+            return;
+        s_stopping = true;
+        pthread_kill( s_listener.native_handle(), s_signal);
+        s_listener.join();
+    }
+#endif
+};
+
+#endif /* stats_hpp */
@@ -0,0 +1,224 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Limits of the scan on a shared host: bytes read and files opened per second, by token buckets of all threads           *
+ *   together; a bucket holds cBurst of its rate, a thread taking more sleeps till it is paid. The CPU time of each         *
+ *   thread is capped to a share of the time passing, by sleeping after each cCpuSlice used. The readers call read() and    *
+ *   open() after the fact; the limits may change anytime, from a control file read again on SIGHUP.                        *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef throttle_hpp
+#define throttle_hpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "base.hpp"
+#include "stats.hpp"
+#ifndef _WIN32
+    #include <signal.h>
+    #include <pthread.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+VERSION( throttle_hpp, 0, 1, 0, 0);
+
+/* a token bucket by its theoretical arrival time: the time all units taken are paid by the rate; it may be ahead of
+   now by cBurst at most, a taker sleeps for the rest. Lock free, the time advanced by compare and exchange           */
+class TokenBucket : Static {
+    std::atomic<u64> m_rate { 0 };  // units per second, 0: unlimited
+    std::atomic<u64> m_paid { 0 };  // ns
+public:
+    static constexpr u64 cBurst = 100 * 1000 * 1000;  // ns
+
+    void setRate(const u64 p_rate) noexcept { m_rate = p_rate; }
+    u64  rate()              const noexcept { return m_rate; }
+
+    /* description:    takes p_units, sleeps till the bucket holds cBurst at most ahead of now
+       return value:   none                                                                                        */
+    void take(const u64 p_units) noexcept {
+        const u64 rate = m_rate.load( std::memory_order_relaxed);
+        if ( rate == 0 || p_units == 0)
+            return;
+        const u64 cost = (u64)((double)p_units * 1e9 / rate);
+        const u64 now = Stats::now();
+        u64 paid = m_paid.load( std::memory_order_relaxed);
+        u64 due;
+        do
+            due = max<u64>( paid, now) + cost;
+        while ( !m_paid.compare_exchange_weak( paid, due, std::memory_order_relaxed));
+        if ( due > now + cBurst)
+            std::this_thread::sleep_for( std::chrono::nanoseconds( due - now - cBurst));
+    }
+};
+
+class Throttle : Static {
+public:
+    static constexpr u64 cCpuSlice = 10 * 1000 * 1000;  // ns
+    enum IoClass : u32 { cIoNone = 0, cIoBestEffort = 2, cIoIdle = 3 };
+
+private:
+    static inline TokenBucket s_bytes;
+    static inline TokenBucket s_files;
+    static inline std::atomic<u32> s_cpu { 0 };  // percent, 0: unlimited
+    static inline std::atomic<bool> s_enabled { false };
+    static inline thread_local u64 t_cpu_mark = 0;
+    static inline const char* s_control = nullptr;
+#ifndef _WIN32
+    static inline std::thread s_listener;
+    static inline std::atomic<bool> s_stopping { false };
+#endif
+
+    static void update() noexcept { s_enabled = s_bytes.rate() > 0 || s_files.rate() > 0 || (s_cpu > 0 && s_cpu < 100); }
+
+    static u64 cpuTime() noexcept {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        struct timespec ts;
+        if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+            return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+        return 0;
+    }
+    // sleeps, when the thread used a cCpuSlice since the last time, as long as it takes to keep to its share
+    static void cpu() noexcept {
+        const u32 share = s_cpu.load( std::memory_order_relaxed);
+        if ( share == 0 || share >= 100)
+            return;
+        const u64 used = cpuTime();
+        if ( t_cpu_mark == 0 || used < t_cpu_mark)
+            t_cpu_mark = used;
+        else if ( used - t_cpu_mark >= cCpuSlice) {
+            std::this_thread::sleep_for( std::chrono::nanoseconds( (used - t_cpu_mark) * (100 - share) / share));
+            t_cpu_mark = used;
+        }
+    }
+
+    static bool number(const char* p_arg, const char* p_name, u64 &p_value) noexcept {
+        const size_t len = strlen( p_name);
+        if ( strncmp( p_arg, p_name, len) != 0)
+            return false;
+        char* end = nullptr;
+        p_value = strtoull( p_arg + len, &end, 10);
+        return end != p_arg + len && *end == 0;
+    }
+
+public:
+    /* description:    sets a limit by an option --limit-read=<MiB/s>, --limit-files=<count/s> or --limit-cpu=<percent>,
+                       0 for none
+       return value:   false, if p_arg is none of them                                                             */
+    static bool parse(const char* p_arg) noexcept {
+        u64 value = 0;
+        if ( number( p_arg, "--limit-read=", value))
+            s_bytes.setRate( value * 1024 * 1024);
+        else if ( number( p_arg, "--limit-files=", value))
+            s_files.setRate( value);
+        else if ( number( p_arg, "--limit-cpu=", value))
+            s_cpu = (u32)min<u64>( value, 100);
+        else
+            return false;
+        update();
+        return true;
+    }
+
+    /* description:    after reading p_bytes: sleeps, if the limits of bytes or of the CPU are reached
+       return value:   none                                                                                        */
+    static void read(const u64 p_bytes) noexcept {
+        if ( !s_enabled.load( std::memory_order_relaxed))
+            return;
+        s_bytes.take( p_bytes);
+        cpu();
+    }
+    /* description:    after opening a file: sleeps, if the limits of files or of the CPU are reached              */
+    static void open() noexcept {
+        if ( !s_enabled.load( std::memory_order_relaxed))
+            return;
+        s_files.take( 1);
+        cpu();
+    }
+    /* description:    where only the CPU is used: sleeps, if its limit is reached                                 */
+    static void work() noexcept {
+        if ( s_enabled.load( std::memory_order_relaxed))
+            cpu();
+    }
+
+    /* description:    sets the I/O scheduling class of the process, the threads started later inherit it; p_level
+                       0..7 for cIoBestEffort, 0 the highest
+       return value:   0 or errno                                                                                  */
+    static int setIoPriority(const IoClass p_class, const u32 p_level = 4) noexcept {
+#if defined __linux__ && defined SYS_ioprio_set
+        constexpr int cWhoProcess = 1;  // IOPRIO_WHO_PROCESS, 0: the calling thread
+        const int ioprio = (int)((p_class << 13) | (p_class == cIoBestEffort ? min<u32>( p_level, 7) : 0));
+        return syscall( SYS_ioprio_set, cWhoProcess, 0, ioprio) == 0 ? 0 : errno;
+#else
+        return p_class == cIoNone ? 0 : ENOSYS;
+#endif
+    }
+
+    /* description:    reads the limits from the file p_path: options of parse(), separated by white space
+       return value:   0 or errno; unknown words are written to stderr and skipped                                 */
+    static int load(const char* p_path) noexcept {
+        FILE* f = fopen( p_path, "r");
+        if ( f == nullptr)
+            return errno;
+        char word[128];
+        while ( fscanf( f, "%127s", word) == 1)
+            if ( !parse( word))
+                fprintf( stderr, "%s: '%s' is no limit, skipped\n", p_path, word);
+        fclose( f);
+        return 0;
+    }
+
+#ifndef _WIN32
+    /* description:    reads the limits from the control file p_path now and again on each SIGHUP, by a thread
+                       waiting for it. The signal is blocked in the calling thread and the threads it starts later:
+                       call it ahead of those
+       return value:   0 or errno of reading it now                                                                */
+    static int control(const char* p_path) {
+        s_control = p_path;
+        const int error = load( p_path);
+        sigset_t set;
+        sigemptyset( &set);
+        sigaddset( &set, SIGHUP);
+        pthread_sigmask( SIG_BLOCK, &set, nullptr);
+        s_listener = std::thread( [set]() {
+            int signal = 0;
+            while ( sigwait( &set, &signal) == 0 && !s_stopping) {
+                const int error = load( s_control);
+                if ( error != 0)
+                    fprintf( stderr, "%s: error %d, the limits are kept\n", s_control, error);
+            }
+        });
+        return error;
+    }
+    /* description:    stops the thread of control()                                                               */
+    static void stopControl() {
+        if ( !s_listener.joinable())
+            return;
+        s_stopping = true;
+        pthread_kill( s_listener.native_handle(), SIGHUP);
+        s_listener.join();
+    }
+#endif
+};
+
+#endif /* throttle_hpp */
@@ -0,0 +1,422 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, Linux only: io_uring, https://kernel.dk/io_uring.pdf, used by its system calls and the         *
+ *   kernel uapi header directly, no liburing                                                                               *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef uring_hpp
+#define uring_hpp
+
+#include "base.hpp"
+#include "sha256.hpp"
+#include "stats.hpp"
+#include "throttle.hpp"
+
+#if defined __linux__ && defined __has_include
+    #if __has_include( <linux/io_uring.h>)
+        #define URING true
+    #endif
+#endif
+#ifndef URING
+    #define URING false
+#endif
+
+#if URING
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+VERSION( uring_hpp, 0, 1, 0, 0);
+
+/* Asynchronous hashing of many files at once on an io_uring. Every file in flight owns a slot: a registered buffer and
+   a direct descriptor of the same index. It is opened, stat'ed and read by a linked chain openat -> statx -> read,
+   further reads follow on completion, the hasher is fed from the completed buffer, then close. Slots are reused, so
+   the queue depth stays up across directories. Results are handed to the Done callback in order of completion.       */
+class UringHasher : Independent {
+public:
+    static constexpr u32 cDepthDefault = 32;
+    static constexpr u32 cDepthMax     = 256;
+    static constexpr u32 cBufferSize   = 256 * 1024;
+
+    struct Result {
+        const char* dir;
+        const char* name;
+        i32  mode;   // st_mode, -1 if statx failed
+        int  error;  // errno of openat, 0 if opened
+        u64  size;   // bytes read
+        Sha256 &sha;
+        FileStamp stamp;  // by statx, invalid if it failed
+        u64  start;       // Stats::start() when queued
+    };
+    typedef void (*Done)( Result &p_result);
+
+private:
+    enum Op : u8 { cOpOpen, cOpStat, cOpRead, cOpClose };
+
+    struct Slot {
+        char dir[ PATH_MAX];
+        char name[ NAME_MAX + 1];
+        char path[ PATH_MAX];
+        struct statx stx;
+        Sha256 sha;
+        u8*  buffer   = nullptr;
+        u64  offset   = 0;
+        u64  start    = 0;
+        u32  pending  = 0;  // completions outstanding
+        int  error    = 0;
+        bool used     = false;
+        bool opened   = false;
+        bool closing  = false;
+        bool stat_ok  = false;
+
+        void reset(const char* p_root_dir, const char* p_file_name, const char* p_path) noexcept {
+            copy( dir, p_root_dir);
+            copy( name, p_file_name);
+            copy( path, p_path);
+            sha.reset();
+            offset  = 0;
+            start   = Stats::start();
+            pending = 0;
+            error   = 0;
+            opened  = closing = stat_ok = false;
+        }
+    private:
+        template <size_t SIZE> static void copy(char (&p_dest)[SIZE], const char* p_src) noexcept {
+            const size_t len = strnlen( p_src, SIZE - 1);
+            memcpy( p_dest, p_src, len);
+            p_dest[len] = 0;
+        }
+    };
+
+    const Done m_done;
+    const u32  m_depth;
+    int   m_fd = -1;
+    bool  m_fixed_buffers = false;
+    u32   m_used = 0;
+    u32   m_to_submit = 0;
+    Slot* m_slots = nullptr;
+    u8*   m_buffers = nullptr;
+
+    // rings, shared with the kernel
+    void* m_sq_ring = MAP_FAILED;
+    void* m_cq_ring = MAP_FAILED;
+    size_t m_sq_ring_len = 0;
+    size_t m_cq_ring_len = 0;
+    size_t m_sqes_len = 0;
+    io_uring_sqe* m_sqes = (io_uring_sqe*)MAP_FAILED;
+    u32 *m_sq_head = nullptr, *m_sq_tail = nullptr, *m_sq_mask = nullptr, *m_sq_array = nullptr, m_sq_entries = 0;
+    u32 *m_cq_head = nullptr, *m_cq_tail = nullptr, *m_cq_mask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+
+    static int setup(const u32 p_entries, io_uring_params &p_params) noexcept {
+        return (int)syscall( __NR_io_uring_setup, p_entries, &p_params);
+    }
+    int enter(const u32 p_to_submit, const u32 p_min_complete) noexcept {
+        int ret;
+        do
+            ret = (int)syscall( __NR_io_uring_enter, m_fd, p_to_submit, p_min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        while (ret < 0 && errno == EINTR);
+        return ret;
+    }
+    int registers(const u32 p_opcode, const void* p_arg, const u32 p_count) noexcept {
+        return (int)syscall( __NR_io_uring_register, m_fd, p_opcode, p_arg, p_count);
+    }
+
+    bool mapRings(const io_uring_params &p) noexcept {
+        m_sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(u32);
+        m_cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            m_sq_ring_len = m_cq_ring_len = max( m_sq_ring_len, m_cq_ring_len);
+        m_sq_ring = mmap( nullptr, m_sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sq_ring == MAP_FAILED)
+            return false;
+        m_cq_ring = (p.features & IORING_FEAT_SINGLE_MMAP) ? m_sq_ring
+            : mmap( nullptr, m_cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ring == MAP_FAILED)
+            return false;
+        m_sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = (io_uring_sqe*)mmap( nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED)
+            return false;
+        u8* const sq = (u8*)m_sq_ring;
+        u8* const cq = (u8*)m_cq_ring;
+        m_sq_head  = (u32*)(sq + p.sq_off.head);
+        m_sq_tail  = (u32*)(sq + p.sq_off.tail);
+        m_sq_mask  = (u32*)(sq + p.sq_off.ring_mask);
+        m_sq_array = (u32*)(sq + p.sq_off.array);
+        m_sq_entries = p.sq_entries;
+        m_cq_head  = (u32*)(cq + p.cq_off.head);
+        m_cq_tail  = (u32*)(cq + p.cq_off.tail);
+        m_cq_mask  = (u32*)(cq + p.cq_off.ring_mask);
+        m_cqes     = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // the kernel must know all opcodes of the chain
+    bool probe() noexcept {
+        const size_t len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        io_uring_probe* const pr = (io_uring_probe*)calloc( 1, len);
+        if (pr == nullptr)
+            return false;
+        bool ok = registers( IORING_REGISTER_PROBE, pr, 256) == 0;
+        constexpr u8 chain_ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE };
+        for (const u8 op : chain_ops)
+            ok = ok && op <= pr->last_op && (pr->ops[op].flags & IO_URING_OP_SUPPORTED);
+        free( pr);
+        return ok;
+    }
+
+    io_uring_sqe& nextSqe(Slot &p_slot, const Op p_op) noexcept {
+        if (*m_sq_tail - __atomic_load_n( m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+            submit( 0);
+        const u32 tail = *m_sq_tail;
+        const u32 index = tail & *m_sq_mask;
+        io_uring_sqe &sqe = m_sqes[index];
+        memset( &sqe, 0, sizeof(sqe));
+        sqe.user_data = (u64)(&p_slot - m_slots) << 2 | p_op;
+        m_sq_array[index] = index;
+        __atomic_store_n( m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        m_to_submit++;
+        p_slot.pending++;
+        return sqe;
+    }
+
+    u32 slotIndex(const Slot &p_slot) const noexcept { return (u32)(&p_slot - m_slots); }
+
+    void prepOpenStatRead(Slot &p_slot) noexcept {
+        io_uring_sqe &open = nextSqe( p_slot, cOpOpen);
+        open.opcode      = IORING_OP_OPENAT;
+        open.fd          = AT_FDCWD;
+        open.addr        = (u64)p_slot.path;
+        open.open_flags  = O_RDONLY;            // a direct descriptor, O_CLOEXEC is not allowed
+        open.file_index  = slotIndex( p_slot) + 1;
+        open.flags       = IOSQE_IO_LINK;
+
+        io_uring_sqe &stat = nextSqe( p_slot, cOpStat);
+        stat.opcode      = IORING_OP_STATX;
+        stat.fd          = AT_FDCWD;
+        stat.addr        = (u64)p_slot.path;
+        stat.len         = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_INO | STATX_MTIME | STATX_CTIME | STATX_NLINK;
+        stat.statx_flags = AT_SYMLINK_NOFOLLOW;
+        stat.addr2       = (u64)&p_slot.stx;
+        stat.flags       = IOSQE_IO_LINK;
+
+        prepRead( p_slot);
+    }
+
+    void prepRead(Slot &p_slot) noexcept {
+        io_uring_sqe &read = nextSqe( p_slot, cOpRead);
+        read.opcode      = m_fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        read.fd          = slotIndex( p_slot);
+        read.flags       = IOSQE_FIXED_FILE;
+        read.addr        = (u64)p_slot.buffer;
+        read.len         = cBufferSize;
+        read.off         = p_slot.offset;
+        read.buf_index   = m_fixed_buffers ? slotIndex( p_slot) : 0;
+    }
+
+    void prepClose(Slot &p_slot) noexcept {
+        p_slot.closing = true;
+        io_uring_sqe &close = nextSqe( p_slot, cOpClose);
+        close.opcode     = IORING_OP_CLOSE;
+        close.file_index = slotIndex( p_slot) + 1;
+    }
+
+    void complete(const io_uring_cqe &p_cqe) {
+        Slot &slot = m_slots[p_cqe.user_data >> 2];
+        slot.pending--;
+        switch ((Op)(p_cqe.user_data & 3)) {
+        case cOpOpen:
+            if (p_cqe.res < 0)
+                slot.error = -p_cqe.res;
+            else
+                slot.opened = true;
+            break;
+        case cOpStat:
+            slot.stat_ok = p_cqe.res == 0;
+            break;
+        case cOpRead: {
+            if (!slot.opened)
+                break;
+            if (p_cqe.res == -ECANCELED) { // the statx in front failed, the file is open anyway
+                prepRead( slot);
+                break;
+            }
+            if (p_cqe.res > 0) {
+                Stats::count( Stats::cRead, p_cqe.res);  // by the kernel, the time is not known
+                const u64 start = Stats::start();
+                slot.sha.update( slot.buffer, p_cqe.res);
+                Stats::stop( Stats::cHash, start, p_cqe.res, slot.name);
+                Throttle::read( p_cqe.res);
+                slot.offset += p_cqe.res;
+            }
+            // a short read at the size seen by statx is the end, no need for another read returning 0
+            const bool end = p_cqe.res <= 0 || ((u32)p_cqe.res < cBufferSize && slot.stat_ok && slot.offset >= slot.stx.stx_size);
+            if (end)
+                prepClose( slot);
+            else
+                prepRead( slot);
+        }   break;
+        case cOpClose:
+            slot.opened = false;
+            break;
+        }
+        if (slot.pending == 0 && !slot.opened)
+            finish( slot);
+    }
+
+    void finish(Slot &p_slot) {
+        FileStamp stamp;
+        if ( p_slot.stat_ok) {
+            const struct statx &stx = p_slot.stx;
+            stamp.dev   = makedev( stx.stx_dev_major, stx.stx_dev_minor);
+            stamp.ino   = stx.stx_ino;
+            stamp.size  = stx.stx_size;
+            stamp.nlink = stx.stx_nlink;
+            stamp.mtime = (i64)stx.stx_mtime.tv_sec * 1000000000 + stx.stx_mtime.tv_nsec;
+            stamp.ctime = (i64)stx.stx_ctime.tv_sec * 1000000000 + stx.stx_ctime.tv_nsec;
+        }
+        Result result = { p_slot.dir, p_slot.name, p_slot.stat_ok ? (i32)p_slot.stx.stx_mode : -1, p_slot.error, p_slot.offset, p_slot.sha, stamp, p_slot.start };
+        m_done( result);
+        p_slot.used = false;
+        m_used--;
+    }
+
+    bool popCqe(io_uring_cqe &p_cqe) noexcept {
+        const u32 head = *m_cq_head;
+        if (head == __atomic_load_n( m_cq_tail, __ATOMIC_ACQUIRE))
+            return false;
+        p_cqe = m_cqes[head & *m_cq_mask];
+        __atomic_store_n( m_cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    void submit(const u32 p_wait) {
+        if (enter( m_to_submit, p_wait) < 0)
+            throw new _Exception( errno, "io_uring_enter");
+        m_to_submit = 0;
+        io_uring_cqe cqe;
+        while (popCqe( cqe))
+            complete( cqe);
+    }
+
+    // direct descriptors need kernel 5.15, tried once on the root directory
+    bool selfTest() noexcept {
+        Slot &slot = m_slots[0];
+        slot.reset( "", "", "/");
+        io_uring_sqe &open = nextSqe( slot, cOpOpen);
+        open.opcode      = IORING_OP_OPENAT;
+        open.fd          = AT_FDCWD;
+        open.addr        = (u64)slot.path;
+        open.open_flags  = O_RDONLY | O_DIRECTORY;
+        open.file_index  = 1;
+        io_uring_cqe cqe;
+        bool ok = enter( m_to_submit, 1) >= 0 && popCqe( cqe) && cqe.res >= 0;
+        m_to_submit = 0;
+        if (ok) {
+            prepClose( slot);
+            ok = enter( m_to_submit, 1) >= 0 && popCqe( cqe) && cqe.res >= 0;
+            m_to_submit = 0;
+        }
+        slot.reset( "", "", "");
+        return ok;
+    }
+
+    void release() noexcept {
+        if (m_sqes != MAP_FAILED)
+            munmap( m_sqes, m_sqes_len);
+        if (m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring)
+            munmap( m_cq_ring, m_cq_ring_len);
+        if (m_sq_ring != MAP_FAILED)
+            munmap( m_sq_ring, m_sq_ring_len);
+        if (m_fd >= 0)
+            ::close( m_fd);
+        m_fd = -1;
+        delete[] m_slots;
+        m_slots = nullptr;
+        free( m_buffers);
+        m_buffers = nullptr;
+    }
+
+public:
+    UringHasher(const Done p_done, const u32 p_depth = cDepthDefault) : m_done( p_done), m_depth( max<u32>( 1, min( cDepthMax, p_depth))) {
+        io_uring_params params;
+        memClean( params);
+        m_fd = setup( 4 * m_depth, params);  // a slot has at most 3 requests in flight
+        if (m_fd < 0 || !mapRings( params) || !probe()) {
+            release();
+            return;
+        }
+        if (posix_memalign( (void**)&m_buffers, 4096, (size_t)m_depth * cBufferSize) != 0) {
+            m_buffers = nullptr;
+            release();
+            return;
+        }
+        m_slots = new Slot[ m_depth];
+        iovec* const iov = new iovec[ m_depth];
+        int* const files = new int[ m_depth];
+        for (u32 i = 0; i < m_depth; i++) {
+            m_slots[i].buffer = m_buffers + (size_t)i * cBufferSize;
+            iov[i] = { m_slots[i].buffer, cBufferSize };
+            files[i] = -1;  // sparse table of direct descriptors
+        }
+        // registered buffers are pinned memory, without them plain reads will do
+        m_fixed_buffers = registers( IORING_REGISTER_BUFFERS, iov, m_depth) == 0;
+        const bool files_ok = registers( IORING_REGISTER_FILES, files, m_depth) == 0;
+        delete[] iov;
+        delete[] files;
+        if (!files_ok || !selfTest())
+            release();
+    }
+    ~UringHasher() {
+        release();
+    }
+
+    bool usable() const noexcept { return m_fd >= 0; }
+
+    /* description:    queues the file p_path, known to the output as p_root_dir / p_file_name; waits for a free slot
+       return value:   none, the result goes to the Done callback                                                  */
+    void add(const char* p_root_dir, const char* p_file_name, const char* p_path) {
+        while (m_used == m_depth)
+            submit( 1);
+        Slot* slot = m_slots;
+        while (slot->used)
+            slot++;
+        slot->reset( p_root_dir, p_file_name, p_path);
+        slot->used = true;
+        m_used++;
+        Throttle::open();
+        prepOpenStatRead( *slot);
+        submit( 0);
+    }
+
+    /* description:    waits for all queued files                                                                   */
+    void flush() {
+        while (m_used > 0)
+            submit( 1);
+    }
+};
+
+#endif // URING
+
+#endif /* uring_hpp */
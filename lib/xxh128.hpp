@@ -0,0 +1,369 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   XXH3 128 bit of Y. Collet, the digest of xxh128sum: not cryptographic, for the detection of changes only. Stripes of  *
+ *   64 bytes are mixed into 8 accumulators of 64 bit by multiplications of 32 x 32 bit, with AVX2 where the processor has *
+ *   it; messages of 240 bytes at most take paths of their own. Same interface as Sha256, the digest big endian.           *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ****************************************************************************************************************************/
+
+//  Unpublished Version, NOT To USE
+
+#ifndef xxh128_hpp
+#define xxh128_hpp
+
+#include <string.h>
+#include "base.hpp"
+#if ISA_X86
+    #include <immintrin.h>
+#endif
+
+VERSION( xxh128_hpp, 0, 1, 0, 0);
+
+class Xxh128 {
+public:
+    static constexpr const char cName[] = "xxh128";
+    static constexpr u8 cDigestSize = 16;
+private:
+    static constexpr u64 cStripe          = 64;
+    static constexpr u64 cSecretSize      = 192;
+    static constexpr u64 cStripesPerBlock = (cSecretSize - cStripe) / 8;
+    static constexpr u64 cBufferSize      = 256;  // 4 stripes
+    static constexpr u64 cMidSizeMax      = 240;
+
+    static constexpr u32 cPrime32_1 = 0x9e3779b1u, cPrime32_2 = 0x85ebca77u, cPrime32_3 = 0xc2b2ae3du;
+    static constexpr u64 cPrime64_1 = 0x9e3779b185ebca87ull, cPrime64_2 = 0xc2b2ae3d27d4eb4full, cPrime64_3 = 0x165667b19e3779f9ull,
+                         cPrime64_4 = 0x85ebca77c2b2ae63ull, cPrime64_5 = 0x27d4eb2f165667c5ull;
+    static constexpr u64 cPrimeMx1  = 0x165667919e3779f9ull, cPrimeMx2 = 0x9fb21c651e98df25ull;
+
+    alignas( 64) static constexpr u8 cSecret[cSecretSize] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    struct U128 { u64 low, high; };
+
+    bool finished = false;
+    alignas( 64) u64 m_acc[8];
+    alignas( 64) u8  m_buffer[cBufferSize];
+    u64 m_buffered = 0;
+    u64 m_stripes  = 0;  // of the block, accumulated so far
+    u64 m_total    = 0;
+    DArrayContainer< u8, cDigestSize> m_hash;
+
+    // words are little endian
+    static u64 read64(const u8* p) noexcept {
+        u64 v;
+        memcpy( &v, p, sizeof( v));
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64( v);
+#endif
+        return v;
+    }
+    static u32 read32(const u8* p) noexcept {
+        u32 v;
+        memcpy( &v, p, sizeof( v));
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap32( v);
+#endif
+        return v;
+    }
+    static U128 mul128(const u64 a, const u64 b) noexcept {
+        const unsigned __int128 p = (unsigned __int128)a * b;
+        return { (u64)p, (u64)(p >> 64) };
+    }
+    static u64 mulFold64(const u64 a, const u64 b) noexcept {
+        const U128 p = mul128( a, b);
+        return p.low ^ p.high;
+    }
+    static u64 rotl64(const u64 v, const u32 r) noexcept { return (v << r) | (v >> (64 - r)); }
+    static u32 rotl32(const u32 v, const u32 r) noexcept { return (v << r) | (v >> (32 - r)); }
+    static u64 avalanche64(u64 h) noexcept {
+        h ^= h >> 33;
+        h *= cPrime64_2;
+        h ^= h >> 29;
+        h *= cPrime64_3;
+        return h ^ (h >> 32);
+    }
+    static u64 avalanche(u64 h) noexcept {
+        h ^= h >> 37;
+        h *= cPrimeMx1;
+        return h ^ (h >> 32);
+    }
+    static u64 mix16(const u8* p_in, const u8* p_secret) noexcept {
+        return mulFold64( read64( p_in) ^ read64( p_secret), read64( p_in + 8) ^ read64( p_secret + 8));
+    }
+    static void mix32(U128 &p_acc, const u8* p_in1, const u8* p_in2, const u8* p_secret) noexcept {
+        p_acc.low  += mix16( p_in1, p_secret);
+        p_acc.low  ^= read64( p_in2) + read64( p_in2 + 8);
+        p_acc.high += mix16( p_in2, p_secret + 16);
+        p_acc.high ^= read64( p_in1) + read64( p_in1 + 8);
+    }
+
+    // messages of 0..240 bytes, whole
+    static U128 hashShort(const u8* p_in, const u64 p_len) noexcept {
+        const u8* const s = cSecret;
+        if ( p_len == 0)
+            return { avalanche64( read64( s + 64) ^ read64( s + 72)), avalanche64( read64( s + 80) ^ read64( s + 88)) };
+        if ( p_len <= 3) {
+            const u32 low = ((u32)p_in[0] << 16) | ((u32)p_in[p_len >> 1] << 24) | p_in[p_len - 1] | ((u32)p_len << 8);
+            const u32 high = rotl32( __builtin_bswap32( low), 13);
+            return { avalanche64( low ^ (u64)(read32( s) ^ read32( s + 4))), avalanche64( high ^ (u64)(read32( s + 8) ^ read32( s + 12))) };
+        }
+        if ( p_len <= 8) {
+            const u64 keyed = (read32( p_in) + ((u64)read32( p_in + p_len - 4) << 32)) ^ (read64( s + 16) ^ read64( s + 24));
+            U128 m = mul128( keyed, cPrime64_1 + (p_len << 2));
+            m.high += m.low << 1;
+            m.low  ^= m.high >> 3;
+            m.low  ^= m.low >> 35;
+            m.low  *= cPrimeMx2;
+            m.low  ^= m.low >> 28;
+            return { m.low, avalanche( m.high) };
+        }
+        if ( p_len <= 16) {
+            const u64 flip_low = read64( s + 32) ^ read64( s + 40);
+            const u64 flip_high = read64( s + 48) ^ read64( s + 56);
+            const u64 in_low = read64( p_in);
+            u64 in_high = read64( p_in + p_len - 8);
+            U128 m = mul128( in_low ^ in_high ^ flip_low, cPrime64_1);
+            m.low += (u64)(p_len - 1) << 54;
+            in_high ^= flip_high;
+            m.high += in_high + (u64)(u32)in_high * (cPrime32_2 - 1);
+            m.low ^= __builtin_bswap64( m.high);
+            U128 h = mul128( m.low, cPrime64_2);
+            h.high += m.high * cPrime64_2;
+            return { avalanche( h.low), avalanche( h.high) };
+        }
+        U128 acc = { p_len * cPrime64_1, 0 };
+        if ( p_len <= 128) {
+            if ( p_len > 32) {
+                if ( p_len > 64) {
+                    if ( p_len > 96)
+                        mix32( acc, p_in + 48, p_in + p_len - 64, s + 96);
+                    mix32( acc, p_in + 32, p_in + p_len - 48, s + 64);
+                }
+                mix32( acc, p_in + 16, p_in + p_len - 32, s + 32);
+            }
+            mix32( acc, p_in, p_in + p_len - 16, s);
+        }
+        else {
+            for (u32 i = 0; i < 4; i++)
+                mix32( acc, p_in + 32 * i, p_in + 32 * i + 16, s + 32 * i);
+            acc.low  = avalanche( acc.low);
+            acc.high = avalanche( acc.high);
+            for (u32 i = 4; i < p_len / 32; i++)
+                mix32( acc, p_in + 32 * i, p_in + 32 * i + 16, s + 3 + 32 * (i - 4));
+            mix32( acc, p_in + p_len - 16, p_in + p_len - 32, s + 136 - 17 - 16);
+        }
+        const u64 low = acc.low + acc.high;
+        const u64 high = acc.low * cPrime64_1 + acc.high * cPrime64_4 + p_len * cPrime64_2;
+        return { avalanche( low), 0 - avalanche( high) };
+    }
+
+    // a stripe into the accumulators, the lanes of the pairs swapped for the sums of the input
+    static void accumulate_scalar(u64 (&p_acc)[8], const u8* p_in, const u8* p_secret) noexcept {
+        for (u32 i = 0; i < 8; i++) {
+            const u64 data = read64( p_in + 8 * i);
+            const u64 key = data ^ read64( p_secret + 8 * i);
+            p_acc[i ^ 1] += data;
+            p_acc[i] += (u64)(u32)key * (key >> 32);
+        }
+    }
+#if ISA_X86
+    TARGET_ISA( "avx2") static void
+    accumulate_avx2(u64 (&p_acc)[8], const u8* p_in, const u8* p_secret, const u64 p_stripes) noexcept {
+        __m256i acc0 = _mm256_load_si256( (const __m256i*)&p_acc[0]);
+        __m256i acc1 = _mm256_load_si256( (const __m256i*)&p_acc[4]);
+        for (u64 n = 0; n < p_stripes; n++, p_in += cStripe, p_secret += 8) {
+            const __m256i data0 = _mm256_loadu_si256( (const __m256i*)p_in);
+            const __m256i data1 = _mm256_loadu_si256( (const __m256i*)(p_in + 32));
+            const __m256i key0 = _mm256_xor_si256( data0, _mm256_loadu_si256( (const __m256i*)p_secret));
+            const __m256i key1 = _mm256_xor_si256( data1, _mm256_loadu_si256( (const __m256i*)(p_secret + 32)));
+            const __m256i product0 = _mm256_mul_epu32( key0, _mm256_shuffle_epi32( key0, 0x31));
+            const __m256i product1 = _mm256_mul_epu32( key1, _mm256_shuffle_epi32( key1, 0x31));
+            acc0 = _mm256_add_epi64( acc0, _mm256_add_epi64( product0, _mm256_shuffle_epi32( data0, 0x4e)));
+            acc1 = _mm256_add_epi64( acc1, _mm256_add_epi64( product1, _mm256_shuffle_epi32( data1, 0x4e)));
+        }
+        _mm256_store_si256( (__m256i*)&p_acc[0], acc0);
+        _mm256_store_si256( (__m256i*)&p_acc[4], acc1);
+    }
+#endif
+#if ISA_X86 && !(defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    static inline bool s_avx2 = CpuFeatures::get().avx2;  // the kernel of accumulate, unless set
+    static bool use_avx2() noexcept { return s_avx2; }
+#else
+    static bool use_avx2() noexcept { return false; }
+#endif
+    // p_stripes stripes, the key of each 8 bytes further in the secret
+    static void accumulate(u64 (&p_acc)[8], const u8* p_in, const u8* p_secret, const u64 p_stripes) noexcept {
+#if ISA_X86
+        if ( use_avx2())
+            return accumulate_avx2( p_acc, p_in, p_secret, p_stripes);
+#endif
+        for (u64 n = 0; n < p_stripes; n++)
+            accumulate_scalar( p_acc, p_in + n * cStripe, p_secret + n * 8);
+    }
+    static void scramble(u64 (&p_acc)[8]) noexcept {
+        const u8* const secret = cSecret + cSecretSize - cStripe;
+        for (u32 i = 0; i < 8; i++) {
+            u64 acc = p_acc[i];
+            acc ^= acc >> 47;
+            acc ^= read64( secret + 8 * i);
+            p_acc[i] = acc * cPrime32_1;
+        }
+    }
+    // p_stripes stripes of the message, scrambled at the end of each block of cStripesPerBlock
+    static const u8* consume(u64 (&p_acc)[8], u64 &p_stripes_so_far, const u8* p_in, u64 p_stripes) noexcept {
+        const u8* secret = cSecret + p_stripes_so_far * 8;
+        if ( p_stripes >= cStripesPerBlock - p_stripes_so_far) {
+            u64 stripes = cStripesPerBlock - p_stripes_so_far;
+            do {
+                accumulate( p_acc, p_in, secret, stripes);
+                scramble( p_acc);
+                p_in += stripes * cStripe;
+                p_stripes -= stripes;
+                stripes = cStripesPerBlock;
+                secret = cSecret;
+            } while ( p_stripes >= cStripesPerBlock);
+            p_stripes_so_far = 0;
+        }
+        if ( p_stripes > 0) {
+            accumulate( p_acc, p_in, secret, p_stripes);
+            p_in += p_stripes * cStripe;
+            p_stripes_so_far += p_stripes;
+        }
+        return p_in;
+    }
+    static u64 merge(const u64 (&p_acc)[8], const u8* p_secret, u64 p_start) noexcept {
+        for (u32 i = 0; i < 4; i++)
+            p_start += mulFold64( p_acc[2 * i] ^ read64( p_secret + 16 * i), p_acc[2 * i + 1] ^ read64( p_secret + 16 * i + 8));
+        return avalanche( p_start);
+    }
+
+    void finalize() noexcept {
+        if ( finished)
+            return;
+        U128 h;
+        if ( m_total <= cMidSizeMax)
+            h = hashShort( m_buffer, m_total);
+        else {
+            alignas( 64) u64 acc[8];
+            memcpy( acc, m_acc, sizeof( acc));
+            u8 last[cStripe];
+            const u8* last_stripe = last;
+            if ( m_buffered >= cStripe) {
+                u64 stripes_so_far = m_stripes;
+                consume( acc, stripes_so_far, m_buffer, (m_buffered - 1) / cStripe);
+                last_stripe = m_buffer + m_buffered - cStripe;
+            }
+            else {  // the rest of the stripe before, kept at the end of the buffer
+                memcpy( last, m_buffer + cBufferSize - (cStripe - m_buffered), cStripe - m_buffered);
+                memcpy( last + cStripe - m_buffered, m_buffer, m_buffered);
+            }
+            accumulate( acc, last_stripe, cSecret + cSecretSize - cStripe - 7, 1);
+            h.low  = merge( acc, cSecret + 11, m_total * cPrime64_1);
+            h.high = merge( acc, cSecret + cSecretSize - cStripe - 11, ~(m_total * cPrime64_2));
+        }
+        m_hash.reset();
+        m_hash << ByteArrayOfScalar< u64, Endianes::Big>( h.high) << ByteArrayOfScalar< u64, Endianes::Big>( h.low);
+        finished = true;
+    }
+
+public:
+    Xxh128() noexcept { reset(); }
+
+    /* description:    accumulates the stripes by AVX2 if p_avx2, else by the portable code; to test and time each
+                       kernel, set while nothing is hashed
+       return value:   false, if AVX2 is wanted but not usable                                                      */
+    static bool setAvx2(const bool p_avx2) noexcept {
+#if ISA_X86 && !(defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        if (p_avx2 && !CpuFeatures::get().avx2)
+            return false;
+        s_avx2 = p_avx2;
+        return true;
+#else
+        return !p_avx2;
+#endif
+    }
+
+    u64 payloadLen() const noexcept { return m_total; }
+
+    Xxh128&
+    reset() noexcept {
+        finished = false;
+        m_acc[0] = cPrime32_3; m_acc[1] = cPrime64_1; m_acc[2] = cPrime64_2; m_acc[3] = cPrime64_3;
+        m_acc[4] = cPrime64_4; m_acc[5] = cPrime32_2; m_acc[6] = cPrime64_5; m_acc[7] = cPrime32_1;
+        m_buffered = 0;
+        m_stripes = 0;
+        m_total = 0;
+        m_hash.reset();
+        return *this;
+    }
+
+    /* description:    adds p_len bytes of the message; the last stripe is kept back, its end must be known           */
+    Xxh128&
+    update(const u8* p_data, u64 p_len) noexcept {
+        if ( finished)
+            reset();
+        m_total += p_len;
+        if ( p_len <= cBufferSize - m_buffered) {
+            memcpy( m_buffer + m_buffered, p_data, p_len);
+            m_buffered += p_len;
+            return *this;
+        }
+        const u8* const end = p_data + p_len;
+        if ( m_buffered > 0) {
+            const u64 fill = cBufferSize - m_buffered;
+            memcpy( m_buffer + m_buffered, p_data, fill);
+            p_data += fill;
+            consume( m_acc, m_stripes, m_buffer, cBufferSize / cStripe);
+            m_buffered = 0;
+        }
+        if ( (u64)(end - p_data) > cBufferSize) {
+            p_data = consume( m_acc, m_stripes, p_data, (end - p_data - 1) / cStripe);
+            memcpy( m_buffer + cBufferSize - cStripe, p_data - cStripe, cStripe);  // for a last stripe shorter
+        }
+        memcpy( m_buffer, p_data, end - p_data);
+        m_buffered = end - p_data;
+        return *this;
+    }
+
+    /* description:    adds p_len zero bytes, as update() of as many zeros, the holes of sparse files               */
+    Xxh128&
+    updateZeros(u64 p_len) noexcept {
+        alignas( 64) static constexpr u8 cZeros[16 * 1024] = { 0 };
+        for (; p_len > 0; ) {
+            const u64 n = min<u64>( p_len, sizeof( cZeros));
+            update( cZeros, n);
+            p_len -= n;
+        }
+        return *this;
+    }
+
+    ArraySpan<u8> hash() noexcept {
+        finalize();
+        return m_hash.reader();
+    }
+};
+
+#endif /* xxh128_hpp */
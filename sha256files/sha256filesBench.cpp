@@ -0,0 +1,687 @@
+/****************************************************************************************************************************
+ * Copyleft (c) 2022 by Marco Gerodetti                                                                                     *
+ *                                                                                                                          *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public        *
+ * License as published by the Free Software Foundation, version 2. This program is distributed WITHOUT ANY WARRANTY;       *
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public     *
+ * License for more details <http://www.gnu.org/licenses/gpl-2.0.html>.                                                     *
+ *                                                                                                                          *
+ *   written in simple C++, POSIX compatibility for Environmental requirements                                              *
+ *                                                                                                                          *
+ *   Benchmarks of sha256files, written as JSON to stdout: the test vectors of SHA-256, SHA-512, SHA-512/256 and xxh128     *
+ *   through every path and every kernel the processor has first, then the hash kernel in cycles per byte by message size,  *
+ *   the read path Sha256 << File with a cold and a warm page cache, and the whole program on a synthetic tree. Exits with  *
+ *   1, if a test vector fails.                                                                                             *
+ *                                                                                                                          *
+ * build instruction on UNIX/LINUX:                                                                                         *
+ *    $  g++ sha256filesBench.cpp -osha256filesBench -std=c++17 -s -Ofast -pthread                                          *
+ *                                                                                                                          *
+ * design paradigms:                                                                                                        *
+ *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
+ *   Few Sourcefile & libs                       => easy to handle, few complexity                                          *
+ ***************************************************************************************************************************/
+
+ //  Unpublished Version, NOT To USE
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/io.hpp"
+#include "../lib/sha256mb.hpp"
+#include "../lib/sha512.hpp"
+#include "../lib/xxh128.hpp"
+
+#ifndef _WIN32
+    #include <sys/wait.h>
+#endif
+#if ISA_X86 && !defined _MSC_VER
+    #include <x86intrin.h>
+#endif
+
+/* command line                                                                                                       */
+struct BenchOptions {
+    bool kernel = true;
+    bool reader = true;
+    bool tree   = true;
+    bool quick  = false;           // messages up to 16 MiB, a smaller file and tree
+    const char* dir  = "/tmp";     // of the file and the tree
+    const char* exe  = nullptr;    // the sha256files binary to time on the tree
+    const char* args = "";         // its options
+    u64 file_size = 256;           // MiB
+    u32 fanout    = 4;             // subdirectories per directory
+    u32 depth     = 3;
+    u32 files     = 100;           // per directory
+    u64 size_min  = 0;             // bytes, log-uniform between
+    u64 size_max  = 1024 * 1024;
+    u64 seed      = 1;
+
+    /* description:    parses the command line
+       return value:   false on unknown options                                                                    */
+    bool parse(const int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+            u64 value = 0;
+            if ( strcmp( arg, "--only=kernel") == 0)
+                reader = tree = false;
+            else if ( strcmp( arg, "--only=reader") == 0)
+                kernel = tree = false;
+            else if ( strcmp( arg, "--only=tree") == 0)
+                kernel = reader = false;
+            else if ( strcmp( arg, "--only=vectors") == 0)
+                kernel = reader = tree = false;
+            else if ( strcmp( arg, "--quick") == 0)
+                quick = true;
+            else if ( strncmp( arg, "--dir=", 6) == 0 && arg[6] != 0)
+                dir = arg + 6;
+            else if ( strncmp( arg, "--exe=", 6) == 0 && arg[6] != 0)
+                exe = arg + 6;
+            else if ( strncmp( arg, "--args=", 7) == 0)
+                args = arg + 7;
+            else if ( optionValue( arg, "--file-size=", value) && value > 0)
+                file_size = value;
+            else if ( optionValue( arg, "--fanout=", value))
+                fanout = (u32)min<u64>( value, 64);
+            else if ( optionValue( arg, "--depth=", value))
+                depth = (u32)min<u64>( value, 16);
+            else if ( optionValue( arg, "--files=", value))
+                files = (u32)min<u64>( value, 100000);
+            else if ( optionValue( arg, "--size-min=", value))
+                size_min = value;
+            else if ( optionValue( arg, "--size-max=", value))
+                size_max = value;
+            else if ( optionValue( arg, "--seed=", value))
+                seed = value;
+            else
+                return false;
+        }
+        if ( size_max < size_min)
+            size_max = size_min;
+        if ( quick)
+            file_size = min<u64>( file_size, 32);
+        return true;
+    }
+
+    static void usage(const char* progName) {
+        printf("syntax: %s [options]\n", progName);
+        printf("  --only=<part>      vectors, kernel, reader or tree; the test vectors run always\n");
+        printf("  --quick            messages up to 16 MiB, a file of 32 MiB at most\n");
+        printf("  --dir=<path>       where the file and the tree are created, default /tmp\n");
+        printf("  --file-size=<MiB>  of the file read, default 256 MiB\n");
+        printf("  --exe=<path>       sha256files to time on the tree; without, the tree is left out\n");
+        printf("  --args=<options>   its options, separated by blanks\n");
+        printf("  --fanout=<count>   subdirectories per directory of the tree, default 4\n");
+        printf("  --depth=<count>    levels of subdirectories, default 3\n");
+        printf("  --files=<count>    files per directory, default 100\n");
+        printf("  --size-min=<bytes> --size-max=<bytes>  file sizes, log-uniform, default 0..1 MiB\n");
+        printf("  --seed=<number>    of the sizes and contents, default 1\n");
+    }
+private:
+    // --name=<decimal number>
+    static bool optionValue(const char* arg, const char* name, u64 &value) {
+        const size_t len = strlen( name);
+        if ( strncmp( arg, name, len) != 0)
+            return false;
+        char* end = nullptr;
+        value = strtoull( arg + len, &end, 10);
+        return end != arg + len && *end == 0;
+    }
+};
+
+static BenchOptions options;
+
+/* clocks of a measurement: wall time in ns and, on x86, the time stamp counter                                       */
+struct Clock {
+    static u64 ns() noexcept {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts);
+        return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+    static u64 cycles() noexcept {
+#if ISA_X86
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+    u64 start_ns     = ns();
+    u64 start_cycles = cycles();
+    u64 elapsedNs()                             const noexcept { return ns() - start_ns; }
+    u64 elapsedCycles()                         const noexcept { return cycles() - start_cycles; }
+};
+
+/* xorshift64*, reproducible by the seed                                                                              */
+struct Random {
+    u64 state;
+    explicit Random(const u64 p_seed) noexcept : state( p_seed * 0x9e3779b97f4a7c15ull + 1) { }
+    u64 next() noexcept {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dull;
+    }
+    void fill(u8* p_data, const u64 p_len) noexcept {
+        for (u64 i = 0; i < p_len; i += 8) {
+            const u64 r = next();
+            memcpy( p_data + i, &r, min<u64>( 8, p_len - i));
+        }
+    }
+};
+
+/* the separators between the parts of the JSON output                                                                */
+struct Json {
+    bool first = true;
+    void item() noexcept {
+        printf( first ? "\n    " : ",\n    ");
+        first = false;
+    }
+    void close(const char* p_end) noexcept {
+        printf( "%s%s", first ? "" : "\n  ", p_end);
+        first = true;
+    }
+};
+
+static Json json;
+
+/**************************************************************************************************************************
+ * test vectors: NIST, FIPS 180-2 appendix B and 180-4 examples, the long messages of the SHA validation system, and
+ * digests of the xxHash reference library 0.8, on every kernel the processor has                                      */
+
+struct TestVector {
+    const char* name;
+    const char* message;  // repeated, zeros if nullptr
+    u64 repeat;
+    const char* digest;
+};
+
+constexpr const char* c448bit = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+constexpr const char* c896bit = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+
+constexpr TestVector cSha256Vectors[] = {
+    { "empty",   "",    1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc",     "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "448bit",  c448bit, 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "896bit",  c896bit, 1, "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+    { "million_a", "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    { "zeros_1MiB", nullptr, 1048576, "30e14955ebf1352266dc2ff8067e68104607e750abb9d3b36582b8af909fcb58" },
+};
+
+constexpr TestVector cSha512Vectors[] = {
+    { "empty",   "",    1, "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+                           "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+    { "abc",     "abc", 1, "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                           "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+    { "896bit",  c896bit, 1, "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+                             "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+    { "million_a", "a", 1000000, "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+                                 "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b" },
+    { "zeros_1MiB", nullptr, 1048576, "d6292685b380e338e025b3415a90fe8f9d39a46e7bdba8cb78c50a338cefca74"
+                                      "1f69e4e46411c32de1afdedfb268e579a51f81ff85e56f55b0ee7c33fe8c25c9" },
+};
+
+constexpr TestVector cSha512_256Vectors[] = {
+    { "empty",   "",    1, "c672b8d1ef56ed28ab87c3622c5114069bdd3ad7b8f9737498d0c01ecef0967a" },
+    { "abc",     "abc", 1, "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23" },
+    { "896bit",  c896bit, 1, "3928e184fb8690f840da3988121d31be65cb9d3ef83ee6146feac861e19b563a" },
+    { "million_a", "a", 1000000, "9a59a052930187a97038cae692f30708aa6491923ef5194394dc68d56c74fb21" },
+    { "zeros_1MiB", nullptr, 1048576, "a4567167dee5ac6bc22a4faed8deae186603b9e10306edfff49b60ce61181a3d" },
+};
+
+// XXH3_128bits, a message in each length class: 0, 1..3, 4..8, 9..16, 17..128, 129..240, stripes and blocks
+constexpr TestVector cXxh128Vectors[] = {
+    { "empty",   "",    1, "99aa06d3014798d86001c324468d497f" },
+    { "abc",     "abc", 1, "06b05ab6733a618578af5f94892f3950" },
+    { "8byte",   "abcdefgh", 1, "dac23237af37353342b702b313880f12" },
+    { "16byte",  "a",  16, "ff9f5054066830d0245750ddc4828d15" },
+    { "448bit",  c448bit, 1, "3d62d22a5169b016c0d894fd4828a1a7" },
+    { "896bit",  c896bit, 1, "97d535cb0c62bf199c12d0b7e499edb8" },
+    { "200byte", "a", 200, "cffe968d25cc79dac8654f5c46034008" },
+    { "1024byte", "a", 1024, "52628c92ccb242754a5d6b09a9587a1c" },
+    { "million_a", "a", 1000000, "a545df8e384a9579b1fd6fae5285c4eb" },
+    { "zeros_1MiB", nullptr, 1048576, "b6ef17a3448492b6918780b90550bf34" },
+};
+
+/* description:    p_digest as lower case hex digits into p_hex, 64 bytes at most
+   return value:   p_hex                                                                                           */
+static char*
+hexOf(char (&p_hex)[129], const ArraySpan<u8> &p_digest) noexcept {
+    u8 i = 0;
+    for (const u8 b : p_digest) {
+        p_hex[i++] = "0123456789abcdef"[b >> 4];
+        p_hex[i++] = "0123456789abcdef"[b & 0x0f];
+    }
+    p_hex[i] = 0;
+    return p_hex;
+}
+
+/* description:    the message of p_vector
+   return value:   the message of p_len bytes, to free()                                                           */
+static u8*
+messageOf(const TestVector &p_vector, u64 &p_len) {
+    const u64 unit = p_vector.message != nullptr ? strlen( p_vector.message) : 0;
+    p_len = p_vector.message != nullptr ? unit * p_vector.repeat : p_vector.repeat;
+    u8* message = (u8*)malloc( p_len + 1);
+    if ( message == nullptr)
+        throw new _Exception( ENOMEM, "test vector");
+    for (u64 i = 0; i < p_len; i++)
+        message[i] = unit > 0 ? (u8)p_vector.message[i % unit] : 0;
+    return message;
+}
+
+/* description:    compares p_digest with the digest of p_vector
+   return value:   1 if it differs, else 0; the line of JSON is written                                            */
+static u32
+checkDigest(const char* p_hasher, const char* p_kernel, const TestVector &p_vector, const char* p_path, const ArraySpan<u8> &p_digest) {
+    char hex[129];
+    const bool ok = strcmp( hexOf( hex, p_digest), p_vector.digest) == 0;
+    json.item();
+    printf( "{ \"hasher\": \"%s\", \"kernel\": \"%s\", \"name\": \"%s\", \"path\": \"%s\", \"ok\": %s }", p_hasher, p_kernel,
+        p_vector.name, p_path, ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
+
+/* description:    every vector by every path of HASHER: one update, byte by byte, in uneven pieces and, for the zeros,
+                   updateZeros
+   return value:   count of failures                                                                               */
+template <typename HASHER, size_t COUNT> static u32
+checkVectors(const char* p_kernel, const TestVector (&p_vectors)[COUNT]) {
+    u32 failed = 0;
+    for (const TestVector &v : p_vectors) {
+        u64 len = 0;
+        u8* message = messageOf( v, len);
+        HASHER sha;
+        failed += checkDigest( HASHER::cName, p_kernel, v, "update", sha.reset().update( message, len).hash());
+        sha.reset();
+        for (u64 i = 0; i < min<u64>( len, 4096); i++)
+            sha.update( message + i, 1);
+        sha.update( message + min<u64>( len, 4096), len - min<u64>( len, 4096));
+        failed += checkDigest( HASHER::cName, p_kernel, v, "bytewise", sha.hash());
+        sha.reset();
+        for (u64 done = 0, piece = 1; done < len; done += piece, piece = piece * 3 + 7)
+            sha.update( message + done, min<u64>( piece, len - done));
+        failed += checkDigest( HASHER::cName, p_kernel, v, "pieces", sha.hash());
+        if ( v.message == nullptr) {
+            sha.reset().updateZeros( 3);
+            failed += checkDigest( HASHER::cName, p_kernel, v, "zeros", sha.updateZeros( len - 3).hash());
+        }
+        free( message);
+    }
+    return failed;
+}
+
+/* description:    every SHA-256 vector through a batch of the multi buffer hash, more messages than lanes, each the
+                   same message
+   return value:   count of failures                                                                               */
+static u32
+checkMultiBuffer(const char* p_kernel) {
+    u32 failed = 0;
+    for (const TestVector &v : cSha256Vectors) {
+        u64 len = 0;
+        u8* message = messageOf( v, len);
+        Sha256Message msgs[17];  // more than the lanes of a batch, the last one short
+        for (Sha256Message &m : msgs) {
+            m.data = message;
+            m.len = len;
+        }
+        Sha256MultiBuffer::hash( msgs, 17);
+        for (u32 i = 1; i < 17; i++)
+            failed += memcmp( msgs[i].hash, msgs[0].hash, 32) != 0 ? 1 : 0;
+        failed += checkDigest( Sha256::cName, p_kernel, v, "multibuffer", msgs[0].digest());
+        free( message);
+    }
+    return failed;
+}
+
+/* description:    the vectors of each hasher on each of its kernels the processor has: SHA-256 by the portable code and
+                   by the SHA extensions, the multi buffer hash in 1, 8 and 16 lanes, xxh128 without and with AVX2;
+                   the kernels chosen by the processor are set again after
+   return value:   count of failures                                                                               */
+static u32
+runVectors() {
+    constexpr bool cOffOn[] = { false, true };
+    constexpr u8 cLanes[] = { 1, 8, 16 };
+    const CpuFeatures &cpu = CpuFeatures::get();
+    u32 failed = 0;
+    printf( "  \"vectors\": [");
+    for (const bool sha_ni : cOffOn)
+        if ( Sha256::setShaNi( sha_ni))
+            failed += checkVectors<Sha256>( sha_ni ? "sha_ni" : "scalar", cSha256Vectors);
+    Sha256::setShaNi( cpu.sha_ni);
+    const u8 lanes = Sha256MultiBuffer::lanes();
+    for (const u8 n : cLanes)
+        if ( Sha256MultiBuffer::setLanes( n))
+            failed += checkMultiBuffer( n == 1 ? "1_lane" : n == 8 ? "8_lanes" : "16_lanes");
+    Sha256MultiBuffer::setLanes( lanes);
+    failed += checkVectors<Sha512>( "scalar", cSha512Vectors);
+    failed += checkVectors<Sha512_256>( "scalar", cSha512_256Vectors);
+    for (const bool avx2 : cOffOn)
+        if ( Xxh128::setAvx2( avx2))
+            failed += checkVectors<Xxh128>( avx2 ? "avx2" : "scalar", cXxh128Vectors);
+    Xxh128::setAvx2( cpu.avx2);
+    json.close( "],\n");
+    return failed;
+}
+
+/**************************************************************************************************************************
+ * the hash kernel                                                                                                     */
+
+/* description:    hashes p_size bytes of p_data by HASHER over and over, a message of p_size bytes each, for 0.2 s
+                   at least; a message larger than p_len is p_data repeated
+   return value:   none, the line of JSON is written                                                               */
+template <typename HASHER> static void
+benchKernel(const u8* p_data, const u64 p_len, const u64 p_size) {
+    static HASHER sha;
+    u64 iterations = 0;
+    Clock clock;
+    do {
+        sha.reset();
+        for (u64 done = 0; done < p_size; done += p_len)
+            sha.update( p_data, min<u64>( p_len, p_size - done));
+        sha.hash();
+        iterations++;
+    } while ( clock.elapsedNs() < 200000000ull || iterations < 3);
+    const double ns = (double)clock.elapsedNs();
+    const double cycles = (double)clock.elapsedCycles();
+    const double bytes = (double)p_size * iterations;
+    json.item();
+    printf( "{ \"name\": \"%s\", \"size\": %llu, \"iterations\": %llu, \"ns_per_message\": %.1f", HASHER::cName,
+        (unsigned long long)p_size, (unsigned long long)iterations, ns / iterations);
+    if ( p_size > 0)
+        printf( ", \"ns_per_byte\": %.4f, \"mb_per_s\": %.1f", ns / bytes, bytes / ns * 1000.0);
+    if ( cycles > 0 && p_size > 0)
+        printf( ", \"cycles_per_byte\": %.3f", cycles / bytes);
+    printf( " }");
+}
+
+static void
+runKernel() {
+    constexpr u64 cChunk = 64 * 1024 * 1024;
+    const u64 size_max = options.quick ? 16 * 1024 * 1024 : 1024 * 1024 * 1024;
+    u8* data = (u8*)malloc( cChunk);
+    if ( data == nullptr)
+        throw new _Exception( ENOMEM, "kernel");
+    Random( options.seed).fill( data, cChunk);
+    printf( "  \"kernel\": [");
+    benchKernel<Sha256>( data, cChunk, 0);
+    for (u64 size = 1; size <= size_max; size *= size < 4096 ? 4 : 16)
+        benchKernel<Sha256>( data, cChunk, size);
+    for (u64 size = 1; size <= size_max; size *= size < 4096 ? 4 : 16)
+        benchKernel<Sha512_256>( data, cChunk, size);
+    for (u64 size = 1; size <= size_max; size *= size < 4096 ? 4 : 16)
+        benchKernel<Xxh128>( data, cChunk, size);
+
+    // the zero path of sparse files
+    static Sha256 sha;
+    Clock clock;
+    sha.reset().updateZeros( size_max).hash();
+    json.item();
+    printf( "{ \"name\": \"sha256_zeros\", \"size\": %llu, \"ns_per_byte\": %.4f", (unsigned long long)size_max,
+        (double)clock.elapsedNs() / size_max);
+    if ( clock.elapsedCycles() > 0)
+        printf( ", \"cycles_per_byte\": %.3f", (double)clock.elapsedCycles() / size_max);
+    printf( " }");
+
+    // small messages side by side in the lanes
+    constexpr u32 cBatch = 256;
+    static Sha256Message msgs[cBatch];
+    for (u64 size = 64; size <= 16384; size *= 4) {
+        u64 batches = 0;
+        Clock batch_clock;
+        do {
+            for (u32 i = 0; i < cBatch; i++) {
+                msgs[i].data = data + (i * size) % (cChunk - size);
+                msgs[i].len = size;
+            }
+            Sha256MultiBuffer::hash( msgs, cBatch);
+            batches++;
+        } while ( batch_clock.elapsedNs() < 200000000ull);
+        const double bytes = (double)size * cBatch * batches;
+        json.item();
+        printf( "{ \"name\": \"sha256_multibuffer\", \"lanes\": %u, \"size\": %llu, \"ns_per_byte\": %.4f",
+            (u32)Sha256MultiBuffer::lanes(), (unsigned long long)size, batch_clock.elapsedNs() / bytes);
+        if ( batch_clock.elapsedCycles() > 0)
+            printf( ", \"cycles_per_byte\": %.3f", batch_clock.elapsedCycles() / bytes);
+        printf( " }");
+    }
+    json.close( "],\n");
+    free( data);
+}
+
+#ifndef _WIN32
+/**************************************************************************************************************************
+ * the read path                                                                                                       */
+
+/* description:    drops the pages of the file from the page cache, written back before
+   return value:   none                                                                                            */
+static void
+dropCache(const char* p_path) noexcept {
+    const int fd = open( p_path, O_RDONLY | O_CLOEXEC);
+    if ( fd < 0)
+        return;
+    fdatasync( fd);
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED);
+    close( fd);
+}
+
+/* description:    Sha256 << File of the file, by read or mmap, cold or warm
+   return value:   none, the line of JSON is written                                                               */
+static void
+benchReader(const char* p_path, const u64 p_size, const bool p_mmap, const bool p_cold) {
+    MappedFileReader::setThreshold( p_mmap ? 1 : 0);
+    if ( p_cold)
+        dropCache( p_path);
+    else {
+        File warm;
+        static Sha256 sha_warm;
+        if ( warm.open( p_path, "r", false), warm.is_open())
+            sha_warm.reset() << warm;
+    }
+    static Sha256 sha;
+    Clock clock;
+    File file;
+    file.open( p_path, "r", false);
+    if ( file.is_open())
+        sha.reset() << file;
+    const double ns = (double)clock.elapsedNs();
+    json.item();
+    printf( "{ \"name\": \"file\", \"read\": \"%s\", \"cache\": \"%s\", \"size\": %llu, \"ok\": %s, \"mb_per_s\": %.1f, \"ns_per_byte\": %.4f }",
+        p_mmap ? "mmap" : "read", p_cold ? "cold" : "warm", (unsigned long long)p_size,
+        sha.payloadLen() == p_size ? "true" : "false", p_size / ns * 1000.0, ns / p_size);
+}
+
+/* description:    writes p_size bytes of p_random to the new file p_path, by blocks of p_block
+   error:          errno of writing                                                                                */
+static void
+writeFile(const char* p_path, const u64 p_size, Random &p_random, u8* p_block, const u64 p_block_size) {
+    const int fd = open( p_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if ( fd < 0)
+        throw new _Exception( errno, p_path);
+    p_random.fill( p_block, min<u64>( p_size, p_block_size));
+    for (u64 done = 0; done < p_size; ) {
+        const auto written = write( fd, p_block, min<u64>( p_size - done, p_block_size));
+        if ( written < 0 && errno == EINTR)
+            continue;
+        if ( written <= 0) {
+            const int error = errno;
+            close( fd);
+            throw new _Exception( error, p_path);
+        }
+        done += written;
+    }
+    close( fd);
+}
+
+static void
+runReader() {
+    constexpr u64 cBlock = 1024 * 1024;
+    char path[PATH_MAX];
+    snprintf( path, sizeof( path), "%s/sha256filesBench.%d.dat", options.dir, (int)getpid());
+    const u64 size = options.file_size * 1024 * 1024;
+    u8* block = (u8*)malloc( cBlock);
+    if ( block == nullptr)
+        throw new _Exception( ENOMEM, "reader");
+    Random random( options.seed);
+    writeFile( path, size, random, block, cBlock);
+    free( block);
+    printf( "  \"reader\": [");
+    for (u8 run = 0; run < 4; run++)  // read cold, warm, mmap cold, warm
+        benchReader( path, size, run >= 2, run % 2 == 0);
+    json.close( "],\n");
+    unlink( path);
+}
+
+/**************************************************************************************************************************
+ * the whole program on a synthetic tree                                                                               */
+
+struct TreeStats {
+    u64 dirs  = 0;
+    u64 files = 0;
+    u64 bytes = 0;
+};
+
+/* description:    a size between options.size_min and size_max, log-uniform
+   return value:   the size                                                                                        */
+static u64
+fileSize(Random &p_random) noexcept {
+    const double low  = log( (double)options.size_min + 1);
+    const double high = log( (double)options.size_max + 1);
+    const double u = (p_random.next() >> 11) * (1.0 / 9007199254740992.0);
+    return max<u64>( options.size_min, min<u64>( options.size_max, (u64)exp( low + (high - low) * u) - 1));
+}
+
+/* description:    the directory p_dir with options.files files and, p_depth levels down, options.fanout subdirectories
+   error:          errno of creating                                                                               */
+static void
+createTree(const char* p_dir, const u32 p_depth, Random &p_random, u8* p_block, const u64 p_block_size, TreeStats &p_stats) {
+    if ( mkdir( p_dir, 0755) != 0)
+        throw new _Exception( errno, p_dir);
+    p_stats.dirs++;
+    char path[PATH_MAX];
+    for (u32 i = 0; i < options.files; i++) {
+        snprintf( path, sizeof( path), "%s/f%u", p_dir, i);
+        const u64 size = fileSize( p_random);
+        writeFile( path, size, p_random, p_block, p_block_size);
+        p_stats.files++;
+        p_stats.bytes += size;
+    }
+    for (u32 i = 0; p_depth > 0 && i < options.fanout; i++) {
+        snprintf( path, sizeof( path), "%s/d%u", p_dir, i);
+        createTree( path, p_depth - 1, p_random, p_block, p_block_size, p_stats);
+    }
+}
+
+/* description:    applies p_file to the path of every file of the tree, and removes the directories after, if p_remove
+   return value:   none                                                                                            */
+template <typename FILE_OP>
+static void
+eachFile(const char* p_dir, FILE_OP p_file, const bool p_remove) {
+    const int fd = open( p_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if ( fd < 0)
+        return;
+    DirectoryReader entries( fd);
+    DirectoryReader::Entry ep;
+    char path[PATH_MAX];
+    while ( entries.next( ep)) {
+        snprintf( path, sizeof( path), "%s/%s", p_dir, ep.name);
+        if ( ep.type == DT_DIR)
+            eachFile( path, p_file, p_remove);
+        else
+            p_file( path);
+    }
+    close( fd);
+    if ( p_remove)
+        rmdir( p_dir);
+}
+
+/* description:    runs options.exe with options.args on p_dir, its output dropped
+   return value:   the exit status, -1 if it did not run                                                           */
+static int
+runProgram(const char* p_dir) {
+    char args[4096];
+    snprintf( args, sizeof( args), "%s", options.args);
+    char* argv[256];
+    int argc = 0;
+    argv[argc++] = (char*)options.exe;
+    for (char* arg = strtok( args, " "); arg != nullptr && argc < 254; arg = strtok( nullptr, " "))
+        argv[argc++] = arg;
+    argv[argc++] = (char*)p_dir;
+    argv[argc] = nullptr;
+    fflush( stdout);
+    const pid_t pid = fork();
+    if ( pid == 0) {
+        const int null_fd = open( "/dev/null", O_WRONLY);
+        dup2( null_fd, 1);
+        execv( options.exe, argv);
+        _exit( 127);
+    }
+    int status = 0;
+    if ( pid < 0 || waitpid( pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED( status) ? WEXITSTATUS( status) : -1;
+}
+
+static void
+runTree() {
+    if ( options.exe == nullptr) {
+        printf( "  \"tree\": { \"skipped\": \"no --exe\" },\n");
+        return;
+    }
+    constexpr u64 cBlock = 1024 * 1024;
+    char dir[PATH_MAX];
+    snprintf( dir, sizeof( dir), "%s/sha256filesBench.%d.tree", options.dir, (int)getpid());
+    u8* block = (u8*)malloc( cBlock);
+    if ( block == nullptr)
+        throw new _Exception( ENOMEM, "tree");
+    Random random( options.seed);
+    TreeStats stats;
+    createTree( dir, options.quick ? min<u32>( options.depth, 2) : options.depth, random, block, cBlock, stats);
+    free( block);
+    printf( "  \"tree\": { \"dirs\": %llu, \"files\": %llu, \"bytes\": %llu, \"args\": \"%s\", \"runs\": [",
+        (unsigned long long)stats.dirs, (unsigned long long)stats.files, (unsigned long long)stats.bytes, options.args);
+    for (u8 run = 0; run < 2; run++) {
+        const bool cold = run == 0;
+        if ( cold)
+            eachFile( dir, []( const char* p_path) { dropCache( p_path); }, false);
+        Clock clock;
+        const int status = runProgram( dir);
+        const double s = clock.elapsedNs() / 1e9;
+        json.item();
+        printf( "{ \"cache\": \"%s\", \"status\": %d, \"seconds\": %.3f, \"files_per_s\": %.0f, \"mb_per_s\": %.1f }",
+            cold ? "cold" : "warm", status, s, stats.files / s, stats.bytes / s / 1e6);
+    }
+    json.close( "] },\n");
+    eachFile( dir, []( const char* p_path) { unlink( p_path); }, true);
+}
+#endif
+
+/* description:    Program entry point
+   return value:   1, if a test vector failed; 2 on errors                                                         */
+int main(int argc, char **argv)
+{
+    DStringContainer<1024> text_buffer;
+    if ( !options.parse( argc, argv)) {
+        BenchOptions::usage( argv[0]);
+        return 2;
+    }
+    try {
+        const CpuFeatures &cpu = CpuFeatures::get();
+        printf( "{\n  \"host\": { \"sha_ni\": %s, \"avx2\": %s, \"avx512\": %s, \"lanes\": %u, \"cycles\": \"%s\" },\n",
+            cpu.sha_ni ? "true" : "false", cpu.avx2 ? "true" : "false", cpu.avx512 ? "true" : "false",
+            (u32)Sha256MultiBuffer::lanes(), ISA_X86 ? "tsc" : "none");
+        const u32 failed = runVectors();
+        if ( options.kernel)
+            runKernel();
+#ifndef _WIN32
+        if ( options.reader)
+            runReader();
+        if ( options.tree)
+            runTree();
+#endif
+        printf( "  \"failed\": %u\n}\n", failed);
+        return failed > 0 ? 1 : 0;
+    }
+    catch (const Exception* ex) {  // the libs throw new _Exception(..)
+        text_buffer.reset() << *ex;
+        fputs(text_buffer.reader().begin(), stderr);
+    }
+    return 2;
+}
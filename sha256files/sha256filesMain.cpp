@@ -10,7 +10,7 @@
  *   using c++ ISO/IEC 14882:2011, POSIX c-libs IEEE Std 1003.1, https://pubs.opengroup.org/onlinepubs/9699919799/).        *
  *                                                                                                                          *
  * build instruction on UNIX/LINUX:                                                                                         *
- *    $  g++ sha256filesMain.cpp -osha256file -std=c++17 -s -Ofast                                                          *
+ *    $  g++ sha256filesMain.cpp -osha256file -std=c++17 -s -Ofast -pthread                                                 *
  *                                                                                                                          *
  * design paradigms:                                                                                                        *
  *   POSIX libs & environment using              => high compatibility, no 3rd party libs                                   *
@@ -20,8 +20,23 @@
  //  Unpublished Version, NOT To USE
 
 #include <time.h>
+#include <stdlib.h>
 #include <string.h>
+#include <type_traits>
 #include "../lib/io.hpp"
+#include "../lib/output.hpp"
+#include "../lib/sha256mb.hpp"
+#include "../lib/sha512.hpp"
+#include "../lib/xxh128.hpp"
+#include "../lib/uring.hpp"
+#include "../lib/pool.hpp"
+#include "../lib/pipeline.hpp"
+#include "../lib/sha256tree.hpp"
+#include "../lib/hashcache.hpp"
+#include "../lib/linkmap.hpp"
+#include "../lib/manifest.hpp"
+#include "../lib/stats.hpp"
+#include "../lib/throttle.hpp"
 
 #if defined _WIN32
     #include <io.h>
@@ -50,17 +65,6 @@ operator << (DString& p_s, const tm* t) noexcept {
 }
 
 
-
-struct timer {
-    time_t start = time(nullptr);
-    void reset(tm &t) {
-        start = time(nullptr);
-    }
-    double runtime() {
-        return difftime(time(nullptr), start);
-    }
-};
-
 typedef  Pair< const u8, const CString> DtPair;
 
 constexpr CStringInstance cFIFO ("FIFO");
@@ -72,6 +76,9 @@ constexpr CStringInstance cFILE ("FILE");
 constexpr CStringInstance cSOCK ("SOCK");
 constexpr CStringInstance cWHT  ("WHT ");
 constexpr CStringInstance cUNKNOWN  ("??? ");
+constexpr CStringInstance cTREE ("TREE");  // --tree: a regular file with the Merkle root as hash, its CHNK records follow
+constexpr CStringInstance cCHNK ("CHNK");
+constexpr CStringInstance cHLNK ("HLNK");  // --hardlinks: a regular file, another link to an inode hashed before
 
 constexpr DtPair rDT_UNKNOWN  ();
 
@@ -81,126 +88,1303 @@ constexpr  KeyPairs< const u8, const CString> fileTypName ( {fileTypeList,  { DT
 const static KeyPairs< u16, FileType> posixFileTyps ({ { S_IFDIR, DT_DIR}, { S_IFLNK, DT_LNK}, { S_IFBLK, DT_BLK}, { S_IFREG, DT_REG}}, {0, DT_UNKNOWN});
 
 
-void searchDir(const char* p_root_dir, const char* p_file_name, FileType type = DT_UNKNOWN) {
-#if defined _WIN32
-    HANDLE dir_handle = nullptr;
-    WIN32_FIND_DATAA ep = { 0 };
-#else
-    DIR *dir_handle = NULL;
-    struct dirent *ep;
-#endif
-    DStringContainer<PATH_MAX> this_path_container;
-    this_path_container.reset() << p_root_dir;
+constexpr DString&
+joinPath(DString& p_path, const char* p_root_dir, const char* p_file_name) noexcept {
+    p_path.reset() << p_root_dir;
     if (*p_file_name) {
         if (( strlen( p_root_dir) == 1 ) && ( *p_root_dir == path_separator ))
-            this_path_container << p_file_name;
-        else 
-            this_path_container << path_separator << p_file_name;
+            p_path << p_file_name;
+        else
+            p_path << path_separator << p_file_name;
     }
-    auto this_path = this_path_container.reader();
+    return p_path;
+}
+
+/* description:    as above, into a plain buffer, which is not cleared ahead
+   return value:   p_path                                                                                          */
+const char*
+joinPath(char (&p_path)[PATH_MAX], const char* p_root_dir, const char* p_file_name) noexcept {
+    size_t len = strnlen( p_root_dir, PATH_MAX - 1);
+    memcpy( p_path, p_root_dir, len);
+    if (*p_file_name) {
+        if ( !(len == 1 && *p_root_dir == path_separator) && len < PATH_MAX - 1)
+            p_path[len++] = path_separator;
+        const size_t name_len = strnlen( p_file_name, PATH_MAX - 1 - len);
+        memcpy( p_path + len, p_file_name, name_len);
+        len += name_len;
+    }
+    p_path[len] = 0;
+    return p_path;
+}
+
+/* output record: TYPE|mode|size|hash|dir/|name, the fields in front of dir formatted into a RecordText; kept as they
+   are as well, for the binary manifest                                                                               */
+struct RecordText : FieldText<256> {  // a digest of SHA-512 takes 128 hex digits
+    char type[4]    = { 0 };
+    i32  mode       = -1;         // -1 if none
+    u64  size       = 0;
+    int  error      = 0;          // errno of an error record
+    bool hashed     = false;      // digest holds the SHA-256 of the file
+    u8   digest[32] = { 0 };
+};
+
+constexpr char cNoHash[] = "                                                                |";
+
+RecordText&
+serializeTypeAndMode(RecordText& outStr, const CString &tp, const i32 file_mode) noexcept {
+    memcpy( outStr.type, tp.begin(), min<u64>( tp.count(), sizeof( outStr.type)));
+    outStr.mode   = file_mode;
+    outStr.size   = 0;
+    outStr.error  = 0;
+    outStr.hashed = false;
+    outStr.reset().put( tp.begin(), (u32)tp.count()).put( '|');
 #ifndef _WIN32
-    i32 file_mode = -1;
-    struct stat sb;
-    if ( lstat( this_path.begin(), &sb) != -1){
-      //  if (type == DT_UNKNOWN){
-        type =  sb.st_mode >> 8 ;
-        type = posixFileTyps.valueOf( sb.st_mode >> 8);
+    if ( file_mode < 0)
+        outStr.put( "    ");
+    else
+        outStr.octal( file_mode, 4);
+    outStr.put( '|');
+#endif
+    return outStr;
+}
+
+RecordText&
+serializeTypeAndMode(RecordText& outStr, const FileType type, const i32 file_mode) noexcept {
+    return serializeTypeAndMode( outStr, fileTypName.valueOf( type), file_mode);
+}
+
+/* description:    the size and the digest; a digest of another hasher than SHA-256 as <p_algorithm>:<hex>, padded
+                   to the width of a SHA-256 one
+   return value:   outStr                                                                                          */
+RecordText&
+serializeSizeAndHash(RecordText& outStr, const u64 size, const ArraySpan<u8> &hash, const char* p_algorithm = nullptr) noexcept {
+    outStr.size = size;
+    outStr.hashed = size > 0 && p_algorithm == nullptr && hash.count() == sizeof( outStr.digest);
+    if ( outStr.hashed)
+        memcpy( outStr.digest, hash.begin(), sizeof( outStr.digest));
+    outStr.decimal( size, 12).put( '|');
+    if (size > 0 && p_algorithm != nullptr) {
+        const u32 len = (u32)(strlen( p_algorithm) + 1 + 2 * hash.count());
+        outStr.put( p_algorithm).put( ':').hex( hash.begin(), hash.count());
+        outStr.put( cNoHash + min<u32>( len, sizeof( cNoHash) - 2));
+    }
+    else if (size > 0 )
+        outStr.hex( hash.begin(), hash.count()).put( '|');
+    else
+        outStr.put( cNoHash);
+    return outStr;
+}
+
+/* description:    the name written with the digests of HASHER, none for SHA-256 of the records as ever            */
+template <typename HASHER> constexpr const char*
+recordAlgorithm(void) noexcept {
+    return std::is_same<HASHER, Sha256>::value ? nullptr : HASHER::cName;
+}
+
+/* description:    the size without hash, of files not hashed or not regular                                       */
+RecordText&
+serializeSize(RecordText& outStr, const u64 size) noexcept {
+    outStr.size = size;
+    outStr.decimal( size, 12).put( '|').put( cNoHash);
+    return outStr;
+}
+
+RecordText&
+serializeError(RecordText& outStr, const int error) noexcept {
+    outStr.error = error;
+    outStr.put( '#').decimal( error, 5, '0').put( " error|").put( cNoHash);
+    return outStr;
+}
+
+/* description:    appends the record as text, p_tag in front if any, to the output buffer of the thread
+   return value:   none                                                                                            */
+void
+writeText(const RecordText& outStr, const char* p_root_dir, const char* p_file_name, const char* p_tag = nullptr) {
+    const char* pieces[] = { p_tag, outStr.begin(), p_root_dir, "/|", p_file_name, "\n" };
+    u64 lens[] = { p_tag != nullptr ? strlen( p_tag) : 0, outStr.len, strlen( p_root_dir), 2, strlen( p_file_name), 1 };
+    OutputBuffer::local().append( &pieces[p_tag != nullptr ? 0 : 1], &lens[p_tag != nullptr ? 0 : 1], p_tag != nullptr ? 6 : 5);
+}
+
+#ifndef _WIN32
+/* --verify: the tree is walked and hashed as by a scan, its records are checked against the manifest instead of
+   written, each found by its path. Only what differs is written: DIFF with the record found, NEW with the record of
+   an entry not in the manifest, MISS with the entries of the manifest not found, at the end. Regular files of another
+   size than in the manifest are not hashed                                                                          */
+class Verifier : Independent {
+    typedef BinaryManifest::Record Record;
+    Manifest m_manifest;
+    std::atomic<bool>* m_found;  // per record of the manifest
+    std::atomic<u64> m_checked { 0 };
+    std::atomic<u64> m_differ  { 0 };
+    std::atomic<u64> m_new     { 0 };
+
+    // the record of dir / name, marked as found
+    const Record* find(const char* p_root_dir, const char* p_file_name) noexcept {
+        const BinaryManifest &records = m_manifest.records();
+        const Record* record = records.find( p_root_dir, p_file_name);
+        if ( record != nullptr)
+            m_found[record - &records.record( 0)] = true;
+        return record;
+    }
+    // of a regular file: TREE and HLNK records are the ones of regular files as well
+    static bool regular(const char* p_type) noexcept {
+        return strncmp( p_type, cFILE.begin(), 4) == 0 || strncmp( p_type, cTREE.begin(), 4) == 0 || strncmp( p_type, cHLNK.begin(), 4) == 0;
+    }
+    static bool same(const RecordText& p_record, const Record& p_entry) noexcept {
+        if ( p_record.error != 0 || (p_entry.flags & BinaryManifest::cError))
+            return p_record.error != 0 && (p_entry.flags & BinaryManifest::cError);  // failed before
+        const bool files = strncmp( p_record.type, cFILE.begin(), 4) == 0 && strncmp( p_entry.type, cHLNK.begin(), 4) == 0;
+        if ( (strncmp( p_record.type, p_entry.type, 4) != 0 && !files) || (p_entry.mode >= 0 && p_entry.mode != p_record.mode))
+            return false;
+        if ( !regular( p_record.type))
+            return true;
+        return (p_entry.size == p_record.size || (p_entry.flags & BinaryManifest::cSizeUnknown)) && (p_record.size == 0
+            || (p_record.hashed && (p_entry.flags & BinaryManifest::cHashed) && memcmp( p_entry.digest, p_record.digest, 32) == 0));
+    }
+public:
+    /* description:    reads the manifest p_manifest, of the tree at p_root; files are tree hashed by the chunk size
+                       of its CHNK records, if it has
+       error:          of Manifest                                                                                 */
+    Verifier(const char* p_manifest, const char* p_root) : m_manifest( p_manifest, p_root) {
+        if ( m_manifest.skipped() > 0)
+            fprintf( stderr, "%llu lines of the manifest are no entries, skipped\n", (unsigned long long)m_manifest.skipped());
+        Sha256Tree::setChunkSize( m_manifest.chunkSize());
+        m_found = new std::atomic<bool>[m_manifest.records().count() + 1]();
+    }
+    ~Verifier() { delete[] m_found; }
+
+    /* description:    checks the record of dir / name, as written by the walk, against the manifest; any thread
+       return value:   none                                                                                        */
+    void check(const RecordText& p_record, const char* p_root_dir, const char* p_file_name) {
+        if ( strncmp( p_record.type, cCHNK.begin(), 4) == 0)
+            return;  // the TREE record holds the root of the chunks
+        const Record* entry = find( p_root_dir, p_file_name);
+        if ( entry == nullptr && m_manifest.sums() && !regular( p_record.type))
+            return;  // sha256sum lists regular files only
+        m_checked++;
+        if ( entry == nullptr) {
+            writeText( p_record, p_root_dir, p_file_name, "NEW |");
+            m_new++;
+        }
+        else if ( !same( p_record, *entry)) {
+            writeText( p_record, p_root_dir, p_file_name, "DIFF|");
+            m_differ++;
+        }
+    }
+
+    /* description:    checks the regular file stat'ed as p_sb by its size, ahead of hashing it
+       return value:   true, if the manifest has it at another size; its DIFF record is written                    */
+    bool sizeDiffers(const struct stat &p_sb, const char* p_root_dir, const char* p_file_name) {
+        const Record* entry = m_manifest.records().find( p_root_dir, p_file_name);
+        if ( entry == nullptr || !regular( entry->type) || (entry->flags & (BinaryManifest::cSizeUnknown | BinaryManifest::cError))
+            || entry->size == (u64)p_sb.st_size)
+            return false;
+        RecordText outStr;
+        serializeTypeAndMode( outStr, Sha256Tree::wanted( p_sb.st_size) ? cTREE : cFILE, p_sb.st_mode & 0xff);
+        serializeSize( outStr, p_sb.st_size);
+        find( p_root_dir, p_file_name);
+        m_checked++;
+        writeText( outStr, p_root_dir, p_file_name, "DIFF|");
+        m_differ++;
+        return true;
+    }
+
+    /* description:    writes the entries of the manifest not found and a summary line, after the walk
+       return value:   the count of entries differing, missing or new                                              */
+    u64 finish() {
+        const BinaryManifest &records = m_manifest.records();
+        char line[ManifestEntry::cKeyMax + 128];
+        u64 missing = 0;
+        for (u64 i = 0; i < records.count(); i++) {
+            const Record &r = records.record( i);
+            if ( m_found[i] || strncmp( r.type, cCHNK.begin(), 4) == 0)
+                continue;
+            const char* pieces[] = { "MISS|", records.format( r, line, sizeof( line)), "\n" };
+            const u64 lens[] = { 5, strlen( line), 1 };
+            OutputBuffer::local().append( pieces, lens, 3);
+            missing++;
+        }
+        char summary[128];
+        snprintf( summary, sizeof( summary), "*VERIFIED* %llu entries: %llu differ, %llu missing, %llu new\n",
+            (unsigned long long)m_checked, (unsigned long long)m_differ, (unsigned long long)missing, (unsigned long long)m_new);
+        OutputBuffer::local().append( summary);
+        return m_differ + missing + m_new;
     }
-    file_mode = sb.st_mode & 0xff;
+};
+
+static std::mutex output_lock;  // of the binary manifest
+static BinaryManifestWriter* binary_manifest = nullptr;  // --binary: the records go there instead of to stdout
+static Verifier* verifier = nullptr;                     // --verify: the records are checked instead of written
+#endif
+
+/* description:    writes the record, to the output buffer of the thread as text, p_tag in front if any; to the binary
+                   manifest or to the verifier instead, if any. A group of records to follow each other is written
+                   under an OutputBuffer::Group
+   return value:   none                                                                                            */
+void
+writeRecord(const RecordText& outStr, const char* p_root_dir, const char* p_file_name, const char* p_tag = nullptr) {
+#ifndef _WIN32
+    if ( verifier != nullptr) {
+        verifier->check( outStr, p_root_dir, p_file_name);
+        return;
+    }
+    if ( binary_manifest != nullptr) {
+        const u16 flags = (outStr.hashed ? BinaryManifest::cHashed : 0) | (outStr.error != 0 ? BinaryManifest::cError : 0);
+        std::lock_guard<std::mutex> guard( output_lock);
+        binary_manifest->add( outStr.type, outStr.mode, outStr.error != 0 ? outStr.error : outStr.size, flags, outStr.digest,
+            p_root_dir, p_file_name);
+        return;
+    }
+#endif
+    writeText( outStr, p_root_dir, p_file_name, p_tag);
+}
+
+#ifndef _WIN32
+static HashCache* hash_cache = nullptr;  // --cache: digests of unchanged files are reused
+static LinkMap* hard_links = nullptr;    // --hardlinks: inodes of several links are read once
+static void flushSmallFiles(void);
+
+/* description:    writes the record of the file as HLNK, if another link to its inode was hashed before, else from
+                   the cache; with --verify, the DIFF record of a file of another size than in the manifest
+   return value:   false, if it is not there or outdated                                                           */
+bool
+writeCachedRecord(const struct stat &p_sb, const char* p_root_dir, const char* p_file_name) {
+    if ( verifier != nullptr)
+        return verifier->sizeDiffers( p_sb, p_root_dir, p_file_name);
+    u8 digest[32];
+    const FileStamp stamp = FileStamp::of( p_sb);
+    RecordText outStr;
+    if ( hard_links != nullptr && p_sb.st_nlink > 1 && hard_links->lookup( stamp, digest))
+        serializeTypeAndMode( outStr, cHLNK, p_sb.st_mode & 0xff);
+    else if ( hash_cache != nullptr && hash_cache->lookup( stamp, digest)) {
+        serializeTypeAndMode( outStr, DT_REG, p_sb.st_mode & 0xff);
+        if ( hard_links != nullptr)
+            hard_links->store( stamp, ArraySpan<u8>({ &digest[0], &digest[32] }));
+    }
+    else
+        return false;
+    serializeSizeAndHash( outStr, p_sb.st_size, ArraySpan<u8>({ &digest[0], &digest[32] }));
+    flushSmallFiles();  // the files batched ahead of it first
+    writeRecord( outStr, p_root_dir, p_file_name);
+    return true;
+}
+
+/* description:    stores the digest in the cache and, for the other links, in the link map, if the file was read
+                   at the size it was stat'ed with
+   return value:   none                                                                                            */
+void
+cacheDigest(const FileStamp &p_stamp, const u64 p_size, const ArraySpan<u8> &p_digest) {
+    if ( !p_stamp.valid() || p_stamp.size != p_size)
+        return;
+    if ( hash_cache != nullptr)
+        hash_cache->store( p_stamp, p_digest);
+    if ( hard_links != nullptr)
+        hard_links->store( p_stamp, p_digest);
+}
+#endif
+
+#ifndef _WIN32
+/* Small regular files are read whole into memory and hashed in batches, side by side in the SIMD lanes of
+   Sha256MultiBuffer. A batch holds the small files following each other in the walk; it is written when it is full
+   and ahead of any other record, so the records stay in the order of the walk                                        */
+class SmallFileBatch : Independent {
+    static constexpr u64 cFileSizeMax = 64 * 1024;
+    static constexpr u32 cFilesMax    = 256;  // per thread
+    static constexpr u64 cDataMax     = 4 * 1024 * 1024;
+    static constexpr u64 cNamesMax    = 128 * 1024;
+    struct Entry {
+        u64 dir;    // offsets in names
+        u64 name;
+        i32 mode;
+        FileStamp stamp;
+        u64 start;  // Stats::start() ahead of opening
+    };
+    Entry         entries[cFilesMax];
+    Sha256Message msgs[cFilesMax];
+    u8            data[cDataMax];
+    char          names[cNamesMax];
+    u32 count      = 0;
+    u64 data_used  = 0;
+    u64 names_used = 0;
+
+    u64 addName(const char* p_name) noexcept {
+        const u64 offset = names_used;
+        const u64 len = strlen( p_name) + 1;
+        memcpy( &names[offset], p_name, len);
+        names_used += len;
+        return offset;
+    }
+public:
+    SmallFileBatch() noexcept { }
+
+    static bool enabled() noexcept { return Sha256MultiBuffer::lanes() > 1; }
+
+    /* description:    reads the file p_at_name relative to p_dir_fd, stat'ed as p_sb, into the batch, if it is a
+                       small regular file
+       return value:   false, if the file is left to the regular path; which reports errors and files growing meanwhile */
+    bool add(const char* p_root_dir, const char* p_file_name, const int p_dir_fd, const char* p_at_name, const struct stat &sb) {
+        if ( !S_ISREG( sb.st_mode) || (u64)sb.st_size > cFileSizeMax)
+            return false;
+        const u64 size = sb.st_size;
+        if ( count == cFilesMax || data_used + size + 1 > cDataMax
+            || names_used + strlen( p_root_dir) + strlen( p_file_name) + 2 > cNamesMax)
+            flush();
+        const u64 start = Stats::start();
+        File this_file;
+        if ( this_file.openAt( p_dir_fd, p_at_name) != 0)
+            return false;
+        u8 resident[(cFileSizeMax + 1) / FileReader::cAlignment + 2];  // pages are 4 KiB at least
+        const bool known = FileReader::noCache() && FileReader::residentPages( this_file.descriptor(), 0, size + 1, resident);
+        const u64 read_start = Stats::start();
+        const u64 readen = this_file.read( &data[data_used], size + 1);
+        Stats::stop( Stats::cRead, read_start, readen, p_file_name);
+        Throttle::read( readen);
+        if ( known)
+            FileReader::dropPages( this_file.descriptor(), 0, readen, resident);
+        if ( readen > size)
+            return false;
+        Entry &e = entries[count];
+        // the entries of one directory share its name
+        e.dir  = ( count > 0 && strcmp( &names[entries[count - 1].dir], p_root_dir) == 0) ? entries[count - 1].dir : addName( p_root_dir);
+        e.name = addName( p_file_name);
+        e.mode = sb.st_mode & 0xff;
+        e.stamp = FileStamp::of( sb);
+        e.start = start;
+        msgs[count].data = &data[data_used];
+        msgs[count].len  = readen;
+        data_used += readen;
+        count++;
+        return true;
+    }
+
+    void flush() {
+        if ( count == 0)
+            return;
+        const u64 start = Stats::start();
+        Sha256MultiBuffer::hash( msgs, count);
+        Stats::stop( Stats::cHash, start, data_used);
+        Throttle::work();
+        RecordText outStr;
+        for (u32 i = 0; i < count; i++) {
+            Stats::file( msgs[i].len, entries[i].start);
+            Stats::span( Stats::cFileSpan, entries[i].start, &names[entries[i].name]);
+            serializeTypeAndMode( outStr, DT_REG, entries[i].mode);
+            serializeSizeAndHash( outStr, msgs[i].len, msgs[i].digest());
+            writeRecord( outStr, &names[entries[i].dir], &names[entries[i].name]);
+            cacheDigest( entries[i].stamp, msgs[i].len, msgs[i].digest());
+        }
+        count = 0;
+        data_used = 0;
+        names_used = 0;
+    }
+};
+
+static thread_local SmallFileBatch* small_files = nullptr;  // per thread, created on its first small file
+
+/* description:    writes the records of the small files batched by the thread, ahead of the next record of the walk
+   return value:   none                                                                                            */
+static void
+flushSmallFiles(void) {
+    if ( small_files != nullptr)
+        small_files->flush();
+}
+#endif
+
+#if URING
+static thread_local UringHasher* uring = nullptr;  // --uring: regular files are hashed asynchronously, per thread
+#endif
+#ifndef _WIN32
+static HashPipeline* pipeline = nullptr;  // --readers, --hashers: regular files are read and hashed on threads of their own
+#endif
+
+/* description:    writes the record of a file hashed asynchronously, RESULT of UringHasher or HashPipeline
+   return value:   none                                                                                            */
+template <typename RESULT> void
+writeHashedRecord(RESULT &p_result) {
+    RecordText outStr;
+    serializeTypeAndMode( outStr, DT_REG, p_result.mode < 0 ? -1 : p_result.mode & 0xff);
+    if ( p_result.error == 0) {
+        const u64 start = Stats::start();
+        p_result.sha.hash();
+        Stats::stop( Stats::cFinal, start, 0, p_result.name);
+        serializeSizeAndHash( outStr, p_result.size, p_result.sha.hash());
+    }
+    else
+        serializeError( outStr, p_result.error);
+    writeRecord( outStr, p_result.dir, p_result.name);
+    if ( p_result.error == 0) {
+        Stats::file( p_result.size, p_result.start);
+        cacheDigest( p_result.stamp, p_result.size, p_result.sha.hash());
+    }
+    Stats::span( Stats::cFileSpan, p_result.start, p_result.name);
+}
+
+/* description:    writes the record of a regular file from the cache, else hands it to the small file batch or to
+                   io_uring of the thread, else to the pipeline. The file is looked up relative to p_dir_fd, the
+                   descriptor of p_root_dir, or by its path at AT_FDCWD. All of them hash SHA-256, files of other
+                   hashers are left to searchDir
+   return value:   false, if it is left to searchDir                                                                */
+template <typename HASHER = Sha256> bool
+hashAside(const char* p_root_dir, const char* p_file_name, const int p_dir_fd = AT_FDCWD) {
+    if ( !std::is_same<HASHER, Sha256>::value)
+        return false;
+#ifndef _WIN32
+    char entry_path[PATH_MAX];
+    const char* at_name = p_dir_fd == AT_FDCWD ? joinPath( entry_path, p_root_dir, p_file_name) : p_file_name;
+    // the batch, the tree, the cache, the link map and the verifier need to stat ahead, io_uring and the pipeline stat
+    // themselves
+    if ( SmallFileBatch::enabled() || Sha256Tree::chunkSize() > 0 || hash_cache != nullptr || hard_links != nullptr
+        || verifier != nullptr) {
+        struct stat sb;
+        const u64 start = Stats::start();
+        const bool stated = fstatat( p_dir_fd, at_name, &sb, AT_SYMLINK_NOFOLLOW) == 0;
+        Stats::stop( Stats::cStat, start);
+        if ( !stated || !S_ISREG( sb.st_mode) || Sha256Tree::wanted( sb.st_size))
+            return false;  // reported or tree hashed by searchDir
+        if ( writeCachedRecord( sb, p_root_dir, p_file_name))
+            return true;
+        if ( hard_links != nullptr && sb.st_nlink > 1)
+            return false;  // hashed by searchDir right now, the digest is there for the later links
+        if ( SmallFileBatch::enabled()) {
+            if ( small_files == nullptr)
+                small_files = new SmallFileBatch();
+            if ( small_files->add( p_root_dir, p_file_name, p_dir_fd, at_name, sb))
+                return true;
+        }
+    }
+    // io_uring and the pipeline open the file later, after the directory may be closed: by its path
+    #if URING
+    if ( uring != nullptr) {
+        uring->add( p_root_dir, p_file_name, p_dir_fd == AT_FDCWD ? at_name : joinPath( entry_path, p_root_dir, p_file_name));
+        return true;
+    }
+    #endif
+    if ( pipeline != nullptr) {
+        pipeline->add( p_root_dir, p_file_name, p_dir_fd == AT_FDCWD ? at_name : joinPath( entry_path, p_root_dir, p_file_name));
+        return true;
+    }
+#endif
+    return false;
+}
+
+/* an entry found by the parallel walk: the directory name and the entry name in one allocation                     */
+struct WalkTask : Independent {
+    char* dir;
+    char* name;
+    FileType type;
+    WalkTask(const char* p_root_dir, const char* p_file_name, const FileType p_type) : type( p_type) {
+        const size_t dir_len = strlen( p_root_dir) + 1;
+        const size_t name_len = strlen( p_file_name) + 1;
+        dir = (char*)malloc( dir_len + name_len);
+        if ( dir == nullptr)
+            throw new _Exception( ENOMEM, "walk task");
+        name = dir + dir_len;
+        memcpy( dir, p_root_dir, dir_len);
+        memcpy( name, p_file_name, name_len);
+    }
+    ~WalkTask() { free( dir); }
+};
+
+static WorkStealingPool<WalkTask>* walkers = nullptr;  // --threads: entries of directories are pushed as tasks
+
+#ifndef _WIN32
+/* description:    tree hashes the first p_size bytes of the descriptor, on the helpers of Sha256Tree; writes the TREE
+                   record and a CHNK record per chunk after it, in chunk order
+   return value:   none                                                                                            */
+void
+writeTreeRecords(RecordText& outStr, const int p_fd, const u64 p_size, const i32 file_mode, const char* p_root_dir, const char* p_file_name) {
+    const u64 chunks = Sha256Tree::chunks( p_size);
+    Sha256Tree::Leaf* leaves = new Sha256Tree::Leaf[chunks];
+    const int error = Sha256Tree::hash( p_fd, p_size, leaves);
+    OutputBuffer::Group group;
+    if ( error != 0) {
+        serializeTypeAndMode( outStr, DT_REG, file_mode);
+        serializeError( outStr, error);
+        writeRecord( outStr, p_root_dir, p_file_name);
+    }
+    else {
+        u64 size = 0;
+        for (u64 i = 0; i < chunks; i++)
+            size += leaves[i].len;
+        Sha256Tree::Leaf root;
+        Sha256Tree::root( leaves, chunks, root.hash);
+        serializeTypeAndMode( outStr, cTREE, file_mode);
+        serializeSizeAndHash( outStr, size, root.digest());
+        writeRecord( outStr, p_root_dir, p_file_name);
+        for (u64 i = 0; i < chunks; i++) {
+            serializeTypeAndMode( outStr, cCHNK, -1);
+            serializeSizeAndHash( outStr, leaves[i].len, leaves[i].digest());
+            writeRecord( outStr, p_root_dir, p_file_name);
+        }
+    }
+    delete[] leaves;
+}
+#endif
+
+#ifndef _WIN32
+/* --order: the entries of a directory, cEntriesMax at a time, the regular files first in the order of FileOrder::key,
+   then the others in the order read. Keys alike stay in the order read                                              */
+class OrderedEntries : Independent {
+public:
+    static constexpr u32 cEntriesMax = 1024;
+    static constexpr u64 cNamesMax   = 64 * 1024;
+private:
+    struct Entry {
+        u64 key;
+        u32 seq;
+        u32 name;  // offset in m_names
+        FileType type;
+    };
+    Entry* m_entries;
+    char*  m_names;
+    u32    m_count = 0;
+
+    static int compare(const void* p1, const void* p2) {
+        const Entry &e1 = *(const Entry*)p1;
+        const Entry &e2 = *(const Entry*)p2;
+        if ( (e1.type == DT_REG) != (e2.type == DT_REG))
+            return e1.type == DT_REG ? -1 : 1;
+        if ( e1.type == DT_REG && e1.key != e2.key)
+            return e1.key < e2.key ? -1 : 1;
+        return e1.seq < e2.seq ? -1 : e1.seq > e2.seq;
+    }
+public:
+    OrderedEntries() : m_entries( (Entry*)malloc( cEntriesMax * sizeof( Entry))), m_names( (char*)malloc( cNamesMax)) {
+        if ( m_entries == nullptr || m_names == nullptr) {
+            free( m_entries);
+            free( m_names);
+            throw new _Exception( ENOMEM, "ordered entries");
+        }
+    }
+    ~OrderedEntries() {
+        free( m_entries);
+        free( m_names);
+    }
+
+    /* description:    reads the next batch from p_entries, of the directory p_dir_fd, and sorts it
+       return value:   false at the end of the directory                                                           */
+    bool fill(DirectoryReader &p_entries, const int p_dir_fd) {
+        m_count = 0;
+        u64 names_used = 0;
+        DirectoryReader::Entry ep;
+        while ( m_count < cEntriesMax && names_used + NAME_MAX + 1 <= cNamesMax && p_entries.next( ep)) {
+            Entry &e = m_entries[m_count];
+            const size_t len = strnlen( ep.name, NAME_MAX);
+            memcpy( &m_names[names_used], ep.name, len);
+            m_names[names_used + len] = 0;
+            e.name = (u32)names_used;
+            e.type = ep.type;
+            e.seq  = m_count++;
+            e.key  = ep.type == DT_REG ? FileOrder::key( p_dir_fd, &m_names[names_used], ep.ino) : 0;
+            names_used += len + 1;
+        }
+        qsort( m_entries, m_count, sizeof( Entry), compare);
+        return m_count > 0;
+    }
+    u32         count()             const noexcept { return m_count; }
+    FileType    type(const u32 i)   const noexcept { return m_entries[i].type; }
+    const char* name(const u32 i)   const noexcept { return &m_names[m_entries[i].name]; }
+};
 #endif
 
-    if (type == DT_DIR || type == DT_UNKNOWN) {
 #if defined _WIN32
+template <typename HASHER>
+void searchDir(const char* p_root_dir, const char* p_file_name, FileType type = DT_UNKNOWN) {
+    HANDLE dir_handle = nullptr;
+    WIN32_FIND_DATAA ep = { 0 };
+    DStringContainer<PATH_MAX> this_path_container;
+    joinPath( this_path_container, p_root_dir, p_file_name);
+    auto this_path = this_path_container.reader();
+
+    if (type == DT_DIR || type == DT_UNKNOWN) {
         DStringContainer<PATH_MAX> dir_name;
         dir_name << this_path << path_separator << "*.*";
         dir_handle = FindFirstFileA(dir_name.begin(), &ep);
-#else
-        dir_handle = opendir(this_path.begin());
-#endif
     }
     if (type == DT_UNKNOWN)
         type = (dir_handle == INVALID_HANDLE_VALUE) ? DT_REG : DT_DIR;
-    
+
     {
-        DStringContainer<2048> outStr;
-        CString tp = fileTypName.valueOf( type);
-        outStr.reset() << tp << '|';
-    #ifndef _WIN32
-        if ( file_mode < 0)
-            outStr << "    ";
-        else{
-            outStr << Scalar< 4,  8, '0'>( file_mode);
-        }
-        outStr << '|';
-    #endif
+        RecordText outStr;
+        serializeTypeAndMode( outStr, type, -1);
         switch (type) {
             case DT_REG: {
                 File this_file;
                 this_file.open( this_path.begin(), "r", false);
-                static Sha256 sha_gen;
+                static thread_local HASHER sha_gen;
                 if ( this_file.is_open()) {
                     sha_gen.reset() << this_file;
-                    u64  size = this_file.tell();  // current file pointer as size
-                    outStr << Num<12, ' '>( size) << '|';
-                    if (size > 0 )
-                        outStr  << sha_gen << '|';
-                    else
-                        outStr << "                                                                |";
+                    u64  size = sha_gen.payloadLen();  // bytes read till the end of file as size
+                    serializeSizeAndHash( outStr, size, sha_gen.hash(), recordAlgorithm<HASHER>());
                 }
                 else
-                    outStr << "#" << Num<5>(errno) << " error|                                                                |";
+                    serializeError( outStr, errno);
             } break;
             default: {
-                outStr << "           0|                                                                |";
+                serializeSize( outStr, 0);
             } break;
         }
-        fputs( outStr.begin(), stdout);
-        fputs( p_root_dir, stdout);
-        fputs("/|", stdout);
-        fputs( p_file_name, stdout);
-        fputs("\n", stdout);
+        writeRecord( outStr, p_root_dir, p_file_name);
     }
     switch (type) {
     case DT_DIR: {
-#if defined _WIN32
         do {
             const FileType ft = (ep.dwFileAttributes & 0x10) ? DT_DIR : DT_REG;
             const char* ep_name = ep.cFileName;
-#else
-        while ((dir_handle != NULL) && (ep = readdir(dir_handle)) != NULL) {
-            FileType ft = ep->d_type;
-            char* ep_name = ep->d_name;
-#endif
             DStringContainer<3> name_firstchars;
             name_firstchars.reset() << ep_name;
             if (!name_firstchars.reader().equals( CStringInstance(".")) && !name_firstchars.reader().equals( CStringInstance(".."))) {
-                DStringContainer< PATH_MAX + 2> entry_path;
-                searchDir( this_path.begin(), ep_name, ft);
+                if ( walkers != nullptr) {
+                    walkers->push( new WalkTask( this_path.begin(), ep_name, ft));
+                    continue;
+                }
+                if ( ft == DT_REG && hashAside<HASHER>( this_path.begin(), ep_name))
+                    continue;
+                searchDir<HASHER>( this_path.begin(), ep_name, ft);
             }
         }
-#if defined _WIN32
         while (dir_handle != nullptr && FindNextFileA(dir_handle, &ep));
-#endif
         } break;
     }
 
     if (dir_handle)
-#if defined _WIN32
         FindClose(dir_handle);
+    }
 #else
-        closedir(dir_handle);
+/* description:    writes the record of p_file_name in p_root_dir and walks it, if it is a directory. The entry is
+                   stat'ed and opened relative to p_dir_fd, the descriptor of p_root_dir held by the caller; by its
+                   path at AT_FDCWD, as the root and the tasks of the parallel walk. The entries of a directory are
+                   read in batches and walked relative to its descriptor, the path of an entry is never looked up.
+                   Regular files are hashed by HASHER
+   return value:   none                                                                                            */
+template <typename HASHER>
+void searchDir(const char* p_root_dir, const char* p_file_name, FileType type = DT_UNKNOWN, const int p_dir_fd = AT_FDCWD) {
+    flushSmallFiles();  // their records ahead of this one
+    char path[PATH_MAX];  // joined for directories only, and for what is looked up by path
+    const char* at_name = p_dir_fd == AT_FDCWD ? joinPath( path, p_root_dir, p_file_name) : p_file_name;
+    i32 file_mode = -1;
+    struct stat sb;
+    u64 start = Stats::start();
+    const bool stated = fstatat( p_dir_fd, at_name, &sb, AT_SYMLINK_NOFOLLOW) == 0;
+    Stats::stop( Stats::cStat, start);
+    int dir_fd = -1;
+    auto openDir = [&]() {
+        start = Stats::start();
+        dir_fd = openat( p_dir_fd, at_name, O_RDONLY | O_NONBLOCK | O_DIRECTORY | O_CLOEXEC);
+        Stats::stop( Stats::cOpenDir, start);
+    };
+    // what opens as a directory is one, links followed, the rest is read as a file
+    if ( stated) {
+        file_mode = sb.st_mode & 0xff;
+        if ( S_ISDIR( sb.st_mode) || S_ISLNK( sb.st_mode))
+            openDir();
+        type = dir_fd >= 0 ? DT_DIR : DT_REG;
+    }
+    else if (type == DT_DIR || type == DT_UNKNOWN) {
+        openDir();
+        if (type == DT_UNKNOWN)
+            type = dir_fd >= 0 ? DT_DIR : DT_REG;
+    }
+
+    {
+        RecordText outStr;
+        bool recorded = false;
+        serializeTypeAndMode( outStr, type, file_mode);
+        switch (type) {
+            case DT_REG: {
+                Stats::Scope scope( Stats::cFileSpan, *p_file_name ? p_file_name : p_root_dir);
+                start = Stats::start();
+                File this_file;
+                const int error = this_file.openAt( p_dir_fd, at_name);
+                static thread_local HASHER sha_gen;
+                struct stat tree_sb;
+                if ( error == 0 && Sha256Tree::chunkSize() > 0 && fstat( this_file.descriptor(), &tree_sb) == 0
+                    && S_ISREG( tree_sb.st_mode) && Sha256Tree::wanted( tree_sb.st_size)) {
+                    writeTreeRecords( outStr, this_file.descriptor(), tree_sb.st_size, file_mode, p_root_dir, p_file_name);
+                    Stats::file( tree_sb.st_size, start);
+                    recorded = true;
+                }
+                else if ( stated && S_ISREG( sb.st_mode) && writeCachedRecord( sb, p_root_dir, p_file_name))
+                    recorded = true;
+                else if ( error == 0) {
+                    sha_gen.reset() << this_file;
+                    u64  size = sha_gen.payloadLen();  // bytes read till the end of file as size
+                    const u64 final_start = Stats::start();
+                    sha_gen.hash();
+                    Stats::stop( Stats::cFinal, final_start, 0, p_file_name);
+                    serializeSizeAndHash( outStr, size, sha_gen.hash(), recordAlgorithm<HASHER>());
+                    Stats::file( size, start);
+                    if ( stated && S_ISREG( sb.st_mode))
+                        cacheDigest( FileStamp::of( sb), size, sha_gen.hash());
+                }
+                else
+                    serializeError( outStr, error);
+            } break;
+            default: {
+                serializeSize( outStr, 0);
+            } break;
+        }
+        if ( !recorded)
+            writeRecord( outStr, p_root_dir, p_file_name);
+    }
+    if ( type == DT_DIR && dir_fd >= 0) {
+        const char* this_path = p_dir_fd == AT_FDCWD ? path : joinPath( path, p_root_dir, p_file_name);
+        Stats::Scope scope( Stats::cDirSpan, this_path);
+        DirectoryReader entries( dir_fd);
+        if ( FileOrder::enabled() && walkers == nullptr) {
+            OrderedEntries ordered;
+            while ( ordered.fill( entries, dir_fd)) {
+                for (u32 i = 0; i < ordered.count(); i++) {
+                    const FileType ft = ordered.type( i);
+                    if ( ft == DT_REG && hashAside<HASHER>( this_path, ordered.name( i), dir_fd))
+                        continue;
+                    if ( ft == DT_REG && i + 1 < ordered.count() && ordered.type( i + 1) == DT_REG)
+                        FileReader::prefetch( dir_fd, ordered.name( i + 1));
+                    searchDir<HASHER>( this_path, ordered.name( i), ft, dir_fd);
+                }
+            }
+        }
+        else {
+            DirectoryReader::Entry ep_next;
+            bool has_next = entries.next( ep_next);
+            while ( has_next) {
+                const FileType ft = ep_next.type;
+                char ep_name[NAME_MAX + 1];
+                const size_t name_len = strnlen( ep_next.name, NAME_MAX);
+                memcpy( ep_name, ep_next.name, name_len);
+                ep_name[name_len] = 0;
+                has_next = entries.next( ep_next);  // one entry ahead, its first buffer is read ahead while this one is hashed
+                if ( walkers != nullptr) {
+                    walkers->push( new WalkTask( this_path, ep_name, ft));
+                    continue;
+                }
+                if ( ft == DT_REG && hashAside<HASHER>( this_path, ep_name, dir_fd))
+                    continue;
+                if ( ft == DT_REG && has_next && ep_next.type == DT_REG)
+                    FileReader::prefetch( dir_fd, ep_next.name);
+                searchDir<HASHER>( this_path, ep_name, ft, dir_fd);
+            }
+        }
+    }
+    if ( dir_fd >= 0)
+        close( dir_fd);
+}
 #endif
+
+#ifndef _WIN32
+/* --duplicates: files of the same content, in three passes. The walk collects the regular files, not empty, by the
+   size of lstat; of each size found more than once, the first and the last cSampleSize bytes are hashed; of those
+   still alike, the whole file. Links to the same inode are read once. Each cluster is written as DUPL| records of the
+   files in it, the largest files first                                                                                */
+class Duplicates : Independent {
+public:
+    static constexpr u64 cSampleSize = 64 * 1024;
+private:
+    enum State : u32 { cListed, cSampled, cHashed, cFailed };
+    struct Candidate {
+        u64   size;
+        u64   dev;
+        u64   ino;
+        u64   seq;    // in the order of the walk
+        u64   dir;    // offsets in m_names
+        u64   name;
+        i32   mode;
+        State state;
+        u8    key[32];  // cSampled: SHA-256 of the samples, cHashed: of the file
+    };
+    Candidate* m_files = nullptr;
+    u64   m_count = 0;
+    u64   m_capacity = 0;
+    char* m_names = nullptr;
+    u64   m_names_used = 0;
+    u64   m_names_capacity = 0;
+    u64   m_bytes_total = 0;
+    u64   m_bytes_read = 0;
+    u64   m_clusters = 0;
+    u64   m_duplicates = 0;
+    u64   m_redundant = 0;
+    Sha256 m_sha;
+
+    u64 addName(const char* p_name) {
+        const u64 len = strlen( p_name) + 1;
+        if ( m_names_used + len > m_names_capacity) {
+            m_names_capacity = max<u64>( 2 * m_names_capacity, m_names_used + len + 64 * 1024);
+            if ( (m_names = (char*)realloc( m_names, m_names_capacity)) == nullptr)
+                throw new _Exception( ENOMEM, "duplicates");
+        }
+        memcpy( m_names + m_names_used, p_name, len);
+        m_names_used += len;
+        return m_names_used - len;
     }
+    void add(const struct stat &p_sb, const u64 p_dir, const char* p_name) {
+        if ( m_count == m_capacity) {
+            m_capacity = max<u64>( 2 * m_capacity, 4096);
+            if ( (m_files = (Candidate*)realloc( m_files, m_capacity * sizeof( Candidate))) == nullptr)
+                throw new _Exception( ENOMEM, "duplicates");
+        }
+        Candidate &c = m_files[m_count];
+        c.size  = p_sb.st_size;
+        c.dev   = p_sb.st_dev;
+        c.ino   = p_sb.st_ino;
+        c.seq   = m_count++;
+        c.dir   = p_dir;
+        c.name  = addName( p_name);
+        c.mode  = p_sb.st_mode & 0xff;
+        c.state = cListed;
+        m_bytes_total += c.size;
+    }
+
+    // the regular files of the tree, no links followed
+    void walk(const char* p_dir, const int p_dir_fd) {
+        const u64 dir = addName( p_dir);
+        DirectoryReader entries( p_dir_fd);
+        DirectoryReader::Entry ep;
+        while ( entries.next( ep)) {
+            struct stat sb;
+            if ( (ep.type != DT_REG && ep.type != DT_DIR && ep.type != DT_UNKNOWN) || fstatat( p_dir_fd, ep.name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            if ( S_ISREG( sb.st_mode) && sb.st_size > 0)
+                add( sb, dir, ep.name);
+            else if ( S_ISDIR( sb.st_mode)) {
+                const int fd = openat( p_dir_fd, ep.name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if ( fd < 0)
+                    continue;
+                char path[PATH_MAX];
+                walk( joinPath( path, p_dir, ep.name), fd);
+                close( fd);
+            }
+        }
+    }
+
+    static int compareInode(const Candidate &a, const Candidate &b) noexcept {
+        return a.dev != b.dev ? (a.dev < b.dev ? -1 : 1) : a.ino != b.ino ? (a.ino < b.ino ? -1 : 1)
+            : a.seq != b.seq ? (a.seq < b.seq ? -1 : 1) : 0;
+    }
+    // the largest first, links to an inode next to each other
+    static int compareSize(const void* p1, const void* p2) {
+        const Candidate &a = *(const Candidate*)p1;
+        const Candidate &b = *(const Candidate*)p2;
+        return a.size != b.size ? (a.size > b.size ? -1 : 1) : compareInode( a, b);
+    }
+    static int compareKey(const void* p1, const void* p2) {
+        const Candidate &a = *(const Candidate*)p1;
+        const Candidate &b = *(const Candidate*)p2;
+        if ( a.state != b.state)
+            return a.state < b.state ? -1 : 1;
+        const int order = memcmp( a.key, b.key, 32);
+        return order != 0 ? order : compareInode( a, b);
+    }
+    static bool sameKey(const Candidate &a, const Candidate &b) noexcept {
+        return a.state == b.state && a.state != cFailed && memcmp( a.key, b.key, 32) == 0;
+    }
+
+    void setKey(Candidate &p_c, const State p_state) {
+        p_c.state = p_state;
+        u8 i = 0;
+        for (const u8 b : m_sha.hash())
+            p_c.key[i++] = b;
+    }
+    // pass 2: the first and the last cSampleSize bytes, the whole file, if that is not more
+    void sample(Candidate &p_c) {
+        static u8 buffer[2 * cSampleSize];
+        char path[PATH_MAX];
+        const int fd = open( joinPath( path, m_names + p_c.dir, m_names + p_c.name), O_RDONLY | O_CLOEXEC);
+        p_c.state = cFailed;
+        if ( fd < 0)
+            return;
+        const bool whole = p_c.size <= 2 * cSampleSize;
+        const u64 head = whole ? p_c.size : cSampleSize;
+        const u64 tail = whole ? 0 : cSampleSize;
+        if ( (u64)pread( fd, buffer, head, 0) == head && (tail == 0 || (u64)pread( fd, buffer + head, tail, p_c.size - tail) == tail)) {
+            m_bytes_read += head + tail;
+            m_sha.reset();
+            m_sha.update( buffer, head + tail);
+            setKey( p_c, whole ? cHashed : cSampled);
+        }
+        close( fd);
+    }
+    // pass 3
+    void hash(Candidate &p_c) {
+        char path[PATH_MAX];
+        File this_file;
+        this_file.open( joinPath( path, m_names + p_c.dir, m_names + p_c.name), "r", false);
+        p_c.state = cFailed;
+        if ( !this_file.is_open())
+            return;
+        m_sha.reset() << this_file;
+        m_bytes_read += m_sha.payloadLen();
+        if ( m_sha.payloadLen() == p_c.size)  // else changed meanwhile
+            setKey( p_c, cHashed);
+    }
+    // applies p_pass to the files of [p_begin, p_end), once per inode
+    template <typename PASS>
+    void each(Candidate* p_begin, Candidate* p_end, PASS p_pass) {
+        for (Candidate* c = p_begin; c < p_end; c++) {
+            if ( c > p_begin && c->dev == c[-1].dev && c->ino == c[-1].ino) {
+                c->state = c[-1].state;
+                memcpy( c->key, c[-1].key, 32);
+            }
+            else
+                p_pass( *c);
+        }
+    }
+
+    void report(Candidate* p_begin, Candidate* p_end) {
+        RecordText outStr;
+        u64 inodes = 0;
+        for (Candidate* c = p_begin; c < p_end; c++) {
+            if ( c == p_begin || c->dev != c[-1].dev || c->ino != c[-1].ino)
+                inodes++;
+            serializeTypeAndMode( outStr, DT_REG, c->mode);
+            serializeSizeAndHash( outStr, c->size, ArraySpan<u8>({ &c->key[0], &c->key[32] }));
+            writeRecord( outStr, m_names + c->dir, m_names + c->name, "DUPL|");
+        }
+        m_clusters++;
+        m_duplicates += p_end - p_begin;
+        m_redundant += (inodes - 1) * p_begin->size;
+    }
+    // the runs of [p_begin, p_end) alike by sameKey, of two files at least, to p_run
+    template <typename RUN>
+    static void runs(Candidate* p_begin, Candidate* p_end, RUN p_run) {
+        for (Candidate* first = p_begin; first < p_end; ) {
+            Candidate* last = first + 1;
+            while ( last < p_end && sameKey( *first, *last))
+                last++;
+            if ( last - first > 1 && first->state != cFailed)
+                p_run( first, last);
+            first = last;
+        }
+    }
+
+public:
+    Duplicates() noexcept { }
+    ~Duplicates() {
+        free( m_files);
+        free( m_names);
+    }
+
+    /* description:    finds the duplicates in the tree at p_root and writes them
+       return value:   count of clusters found                                                                     */
+    u64 run(const char* p_root) {
+        const int fd = open( p_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if ( fd < 0)
+            throw new _Exception( errno, p_root);
+        walk( p_root, fd);
+        close( fd);
+        qsort( m_files, m_count, sizeof( Candidate), compareSize);
+        for (u64 first = 0; first < m_count; ) {
+            u64 last = first + 1;
+            while ( last < m_count && m_files[last].size == m_files[first].size)
+                last++;
+            if ( last - first > 1) {
+                Candidate* begin = &m_files[first];
+                Candidate* end = &m_files[last];
+                each( begin, end, [this]( Candidate &c) { sample( c); });
+                qsort( begin, end - begin, sizeof( Candidate), compareKey);
+                runs( begin, end, [this]( Candidate* p_first, Candidate* p_last) {
+                    if ( p_first->state == cSampled) {
+                        qsort( p_first, p_last - p_first, sizeof( Candidate), compareSize);  // by inode again
+                        each( p_first, p_last, [this]( Candidate &c) { hash( c); });
+                        qsort( p_first, p_last - p_first, sizeof( Candidate), compareKey);
+                        runs( p_first, p_last, [this]( Candidate* p_f, Candidate* p_l) { report( p_f, p_l); });
+                    }
+                    else
+                        report( p_first, p_last);
+                });
+            }
+            first = last;
+        }
+        char summary[192];
+        snprintf( summary, sizeof( summary), "*DUPLICATES* %llu clusters of %llu files, %llu bytes redundant; %llu of %llu bytes read\n",
+            (unsigned long long)m_clusters, (unsigned long long)m_duplicates, (unsigned long long)m_redundant,
+            (unsigned long long)m_bytes_read, (unsigned long long)m_bytes_total);
+        OutputBuffer::local().append( summary);
+        return m_clusters;
+    }
+};
+#endif
 
 struct ArgStr : public ArraySpan<char> {
     ArgStr( char* arg) : ArraySpan<char>( Span< char* const> (arg, arg + strlen(arg))) {}
 };
 
+/* command line: options ahead of the path                                                                            */
+struct Options {
+    static constexpr u32 cThreadsMax = 1024;
+    char* path = nullptr;
+    u32 uring_depth = 0;
+    u32 threads = 1;
+    u32 readers = 0;
+    u32 hashers = 0;
+    u64 inflight = 0;
+    char* cache = nullptr;
+    char* verify = nullptr;
+    char* binary = nullptr;
+    u64 hardlinks = 0;
+    bool duplicates = false;
+    bool stats = false;
+    char* trace = nullptr;
+    char* control = nullptr;
+    Throttle::IoClass io_class = Throttle::cIoNone;
+    u32 io_level = 4;
+    const char* algorithm = Sha256::cName;
+
+    /* description:    parses the command line
+       return value:   false on unknown options, without path, or for options of SHA-256 only with another
+                       algorithm                                                                                   */
+    bool parse(const int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            char* arg = argv[i];
+            u64 value = 0;
+            if ( optionValue( arg, "--buffer=", value))
+                FileReader::setBufferSize( value * 1024);
+            else if ( optionValue( arg, "--threads=", value))
+                threads = WorkStealingPool<WalkTask>::workers( (u32)min<u64>( value, cThreadsMax));
+#ifndef _WIN32
+            else if ( optionValue( arg, "--readers=", value))
+                readers = WorkStealingPool<WalkTask>::workers( (u32)min<u64>( value, HashPipeline::cThreadsMax));
+            else if ( optionValue( arg, "--hashers=", value))
+                hashers = WorkStealingPool<WalkTask>::workers( (u32)min<u64>( value, HashPipeline::cThreadsMax));
+            else if ( optionValue( arg, "--inflight=", value))
+                inflight = value * 1024 * 1024;
+            else if ( strncmp( arg, "--cache=", 8) == 0 && arg[8] != 0)
+                cache = arg + 8;
+            else if ( strcmp( arg, "--rehash") == 0)
+                HashCache::s_rehash = true;
+            else if ( strncmp( arg, "--verify=", 9) == 0 && arg[9] != 0)
+                verify = arg + 9;
+            else if ( strncmp( arg, "--binary=", 9) == 0 && arg[9] != 0)
+                binary = arg + 9;
+            else if ( strcmp( arg, "--duplicates") == 0)
+                duplicates = true;
+            else if ( Throttle::parse( arg))
+                continue;  // --limit-*
+            else if ( strcmp( arg, "--ioprio=idle") == 0)
+                io_class = Throttle::cIoIdle;
+            else if ( strcmp( arg, "--ioprio=be") == 0)
+                io_class = Throttle::cIoBestEffort;
+            else if ( optionValue( arg, "--ioprio=be:", value) && value <= 7) {
+                io_class = Throttle::cIoBestEffort;
+                io_level = (u32)value;
+            }
+            else if ( strncmp( arg, "--control=", 10) == 0 && arg[10] != 0)
+                control = arg + 10;
+            else if ( strcmp( arg, "--hardlinks") == 0)
+                hardlinks = LinkMap::cMemoryDefault;
+            else if ( optionValue( arg, "--hardlinks=", value))
+                hardlinks = max<u64>( value, 1) * 1024 * 1024;
+#endif
+#ifndef _WIN32
+            else if ( strcmp( arg, "--tree") == 0)
+                Sha256Tree::setChunkSize( Sha256Tree::cChunkSizeDefault);
+            else if ( optionValue( arg, "--tree=", value))
+                Sha256Tree::setChunkSize( value * 1024 * 1024);
+#endif
+            else if ( strcmp( arg, "--nocache") == 0)
+                FileReader::setNoCache( true);
+            else if ( strcmp( arg, "--stats") == 0)
+                stats = true;
+            else if ( strcmp( arg, "--algorithm=sha256") == 0)
+                algorithm = Sha256::cName;
+            else if ( strcmp( arg, "--algorithm=sha512-256") == 0)
+                algorithm = Sha512_256::cName;
+            else if ( strcmp( arg, "--algorithm=sha512") == 0)
+                algorithm = Sha512::cName;
+            else if ( strcmp( arg, "--algorithm=xxh128") == 0)
+                algorithm = Xxh128::cName;
+            else if ( strncmp( arg, "--trace=", 8) == 0 && arg[8] != 0)
+                trace = arg + 8;
+#ifndef _WIN32
+            else if ( optionValue( arg, "--mmap=", value))
+                MappedFileReader::setThreshold( value * 1024 * 1024);
+            else if ( strcmp( arg, "--order=inode") == 0)
+                FileOrder::setMode( FileOrder::cInode);
+            else if ( strcmp( arg, "--order=extent") == 0)
+                FileOrder::setMode( FileOrder::cExtent);
+#endif
+#if URING
+            else if ( strcmp( arg, "--uring") == 0)
+                uring_depth = UringHasher::cDepthDefault;
+            else if ( optionValue( arg, "--uring=", value))
+                uring_depth = (u32)min<u64>( value, UringHasher::cDepthMax);
+#endif
+            else if ( arg[0] == '-' && arg[1] == '-')
+                return false;
+            else if ( path == nullptr)
+                path = arg;
+            else
+                return false;
+        }
+        // the cache, the manifests, the tree, the batch and the engines reading aside store and hash SHA-256
+        bool sha256_only = cache != nullptr || verify != nullptr || binary != nullptr || hardlinks > 0 || duplicates
+            || readers > 0 || hashers > 0 || uring_depth > 0;
+#ifndef _WIN32
+        sha256_only = sha256_only || Sha256Tree::chunkSize() > 0;
+#endif
+        if ( algorithm != Sha256::cName && sha256_only) {
+            fprintf( stderr, "--algorithm=%s hashes on the walk only, without --cache, --verify, --binary, --duplicates,"
+                " --hardlinks, --tree, --readers, --hashers and --uring\n", algorithm);
+            return false;
+        }
+        return path != nullptr;
+    }
+
+    static void usage(const char* progName) {
+        printf("syntax: %s [options] <path>\n", progName);
+        printf("  --buffer=<KiB>     read buffer size, %llu..%llu KiB, default %llu KiB\n",
+            (unsigned long long)FileReader::cBufferSizeMin / 1024, (unsigned long long)FileReader::cBufferSizeMax / 1024,
+            (unsigned long long)FileReader::cBufferSizeDefault / 1024);
+        printf("  --threads=<count>  walk and hash in parallel, 0: one thread per processor, default 1\n");
+#ifndef _WIN32
+        printf("  --readers=<count>  read regular files on threads of their own, 0: one per processor\n");
+        printf("  --hashers=<count>  hash what the readers read on threads of their own, 0: one per processor\n");
+        printf("  --inflight=<MiB>   memory of the buffers between readers and hashers, default %llu MiB\n",
+            (unsigned long long)HashPipeline::cInflightDefault / 1024 / 1024);
+#endif
+#ifndef _WIN32
+        printf("  --cache=<file>     reuse the digests of files with unchanged dev, inode, size, mtime and ctime\n");
+        printf("  --rehash           with --cache: hash all files anew and store them\n");
+        printf("  --verify=<file>    check the tree against a manifest of sha256files or a sha256sum list, walked as\n"
+               "                     by a scan: DIFF, MISS and NEW records of what differs, files of another size not\n"
+               "                     hashed\n");
+        printf("  --binary=<file>    write the records to a binary manifest with indexes by path and by digest,\n"
+               "                     instead of the text to stdout; --verify reads it as well\n");
+        printf("  --duplicates       DUPL records of the files alike, by size, then by their first and last %llu KiB,\n"
+               "                     then by the whole file; empty files and symbolic links are left out\n",
+            (unsigned long long)Duplicates::cSampleSize / 1024);
+        printf("  --hardlinks[=<MiB>] read files of several links once: later links of an unchanged inode are HLNK\n"
+               "                     records with the digest of the first; in a table of %llu MiB by default\n",
+            (unsigned long long)LinkMap::cMemoryDefault / 1024 / 1024);
+        printf("  --limit-read=<MiB/s> read this many MiB per second at most, all threads together, default 0: no limit\n");
+        printf("  --limit-files=<count> open this many files per second at most\n");
+        printf("  --limit-cpu=<percent> use this share of a processor per thread at most, sleeping after each %llu ms\n",
+            (unsigned long long)Throttle::cCpuSlice / 1000000);
+        printf("  --ioprio=<class>   I/O scheduling class: idle, or be[:<0..7>] best effort, 0 the highest, default 4\n");
+        printf("  --control=<file>   read limits from the file, as --limit-* options, now and again on SIGHUP\n");
+        printf("  --tree[=<MiB>]     tree hash files larger than a chunk, default %llu MiB: TREE record with the Merkle\n"
+               "                     root, a CHNK record with the SHA-256 of each chunk after it\n",
+            (unsigned long long)Sha256Tree::cChunkSizeDefault / 1024 / 1024);
+#endif
+        printf("  --nocache          leave the page cache as found: read with O_DIRECT, else drop what was read\n");
+        printf("  --mmap=<MiB>       memory map files of at least this size instead of reading them, default 0: off\n");
+        printf("  --algorithm=<name> digest of the files: sha256, the default; sha512-256 or sha512, faster than sha256\n"
+               "                     on 64 bit processors without SHA extensions; xxh128, the XXH3 128 bit of xxh128sum,\n"
+               "                     not cryptographic and several times faster. Recorded as <name>:<hex>\n");
+        printf("  --stats            report to stderr at the end, and on SIGUSR1: the count, the thread seconds and the\n"
+               "                     throughput of each phase, histograms of the file sizes and latencies\n");
+        printf("  --trace=<file>     write each phase of each thread, each file and directory walked serially as an\n"
+               "                     event to the file, Chrome trace JSON, for chrome://tracing or ui.perfetto.dev\n");
+#ifndef _WIN32
+        printf("  --order=<order>    for rotational disks, the serial walk reads the files of a directory, %u at a time,\n"
+               "                     sorted by inode or by extent, their first physical block; the others after them\n",
+            OrderedEntries::cEntriesMax);
+#endif
+#if URING
+        printf("  --uring[=<depth>]  open, stat and read regular files asynchronously on io_uring, %u files in flight\n",
+            UringHasher::cDepthDefault);
+#endif
+    }
+private:
+    // --name=<decimal number>
+    static bool optionValue(const char* arg, const char* name, u64 &value) {
+        const size_t len = strlen( name);
+        if ( strncmp( arg, name, len) != 0)
+            return false;
+        char* end = nullptr;
+        value = strtoull( arg + len, &end, 10);
+        return end != arg + len && *end == 0;
+    }
+};
+
+static Options options;
+
+/* description:    sets up the state of a thread of the walk; the hasher and the read buffer are thread_local
+   return value:   none                                                                                            */
+static void
+enterThread(void) {
+#if URING
+    static std::atomic<bool> uring_failed { false };
+    if ( options.uring_depth > 0 && !uring_failed) {
+        uring = new UringHasher( writeHashedRecord<UringHasher::Result>, options.uring_depth);
+        if ( !uring->usable()) {
+            if ( !uring_failed.exchange( true))
+                fputs("io_uring is not available, reading synchronously\n", stderr);
+            delete uring;
+            uring = nullptr;
+        }
+    }
+#endif
+}
+
+/* description:    writes what the thread has still pending
+   return value:   none                                                                                            */
+static void
+leaveThread(void) {
+#if URING
+    if ( uring != nullptr) {
+        uring->flush();
+        delete uring;
+        uring = nullptr;
+    }
+#endif
+#ifndef _WIN32
+    if ( small_files != nullptr) {
+        small_files->flush();
+        delete small_files;
+        small_files = nullptr;
+    }
+#endif
+}
+
+/* description:    writes the end of the output and, with --stats, the report
+   return value:   none                                                                                            */
+static void
+writeDone(void) {
+    OutputBuffer::local().append( "*DONE*");
+    OutputBuffer::local().flush();
+    Stats::stopTracing();
+#ifndef _WIN32
+    Throttle::stopControl();
+#endif
+    if ( options.stats) {
+#ifndef _WIN32
+        Stats::stopListening();
+#endif
+        Stats::report( stderr);
+    }
+}
+
+/* description:    walks options.path, serially or on a pool of options.threads, hashing by HASHER
+   return value:   none                                                                                            */
+template <typename HASHER> static void
+walk(void) {
+    if ( options.threads > 1) {
+        WorkStealingPool<WalkTask> pool( options.threads);
+        walkers = &pool;
+        pool.push( new WalkTask( options.path, "", DT_UNKNOWN));
+        pool.run( enterThread, []( const WalkTask &p_task) {
+                if ( p_task.type != DT_REG || !hashAside<HASHER>( p_task.dir, p_task.name))
+                    searchDir<HASHER>( p_task.dir, p_task.name, p_task.type);
+            }, leaveThread);
+        walkers = nullptr;
+    }
+    else {
+        enterThread();
+        searchDir<HASHER>(options.path, "");
+        leaveThread();
+    }
+}
+
 /* description:    Program exit point
    return value:   none
    error:          errorNr                                                                                          */
 static void
 exitProgram(void) {
+#ifndef _WIN32
+    Stats::stopListening();  // left running on an exception
+    Throttle::stopControl();
+#endif
+    Stats::stopTracing();
     fflush(nullptr);
 }
 
@@ -210,23 +1394,101 @@ int main(int argc, char **argv)
 {
     atexit(&exitProgram);
     DStringContainer<1024> text_buffer;
+    int result = 0;
 
     try {
-        if (argc == 2) {
-            char& last = argv[1][strlen(argv[1]) - 1];
-            if ( strlen(argv[1]) > 2 && last == path_separator)
+        if (options.parse(argc, argv)) {
+            char& last = options.path[strlen(options.path) - 1];
+            if ( strlen(options.path) > 2 && last == path_separator)
                 last = 0;
-            searchDir(argv[1], "");
-            fputs("*DONE*", stdout);
+#if URING
+            if ( options.uring_depth > 0 && FileReader::noCache()) {
+                fputs("io_uring reads through the page cache, --nocache reads synchronously\n", stderr);
+                options.uring_depth = 0;
+            }
+#endif
+            if ( options.trace != nullptr)
+                Stats::traceTo( options.trace);
+#ifndef _WIN32
+            int error = options.io_class != Throttle::cIoNone ? Throttle::setIoPriority( options.io_class, options.io_level) : 0;
+            if ( error != 0)
+                fprintf( stderr, "the I/O priority can not be set, error %d\n", error);
+            error = options.control != nullptr ? Throttle::control( options.control) : 0;  // ahead of the threads, as Stats::listen
+            if ( error != 0)
+                fprintf( stderr, "%s can not be read, error %d; it is read again on SIGHUP\n", options.control, error);
+#endif
+            if ( options.stats) {
+                Stats::enable();
+#ifndef _WIN32
+                Stats::listen( SIGUSR1);  // ahead of the threads, which inherit the signal blocked
+#endif
+            }
+#ifndef _WIN32
+            if ( options.duplicates && options.verify == nullptr) {
+                Duplicates duplicates;
+                duplicates.run( options.path);
+                writeDone();
+                return result;
+            }
+            if ( options.verify != nullptr)  // the files are hashed anew, nothing is stored
+                verifier = new Verifier( options.verify, options.path);
+            else {
+                if ( options.binary != nullptr)
+                    binary_manifest = new BinaryManifestWriter( options.binary);
+                if ( options.cache != nullptr)
+                    hash_cache = new HashCache( options.cache);
+                if ( options.hardlinks > 0)
+                    hard_links = new LinkMap( options.hardlinks);
+            }
+            if ( options.readers > 0 || options.hashers > 0)
+                pipeline = new HashPipeline( writeHashedRecord<HashPipeline::Result>, max<u32>( options.readers, 1),
+                    max<u32>( options.hashers, 1), options.inflight > 0 ? options.inflight : HashPipeline::cInflightDefault);
+#endif
+            if ( options.algorithm == Xxh128::cName)
+                walk<Xxh128>();
+            else if ( options.algorithm == Sha512_256::cName)
+                walk<Sha512_256>();
+            else if ( options.algorithm == Sha512::cName)
+                walk<Sha512>();
+            else
+                walk<Sha256>();
+#ifndef _WIN32
+            if ( pipeline != nullptr) {
+                pipeline->flush();
+                delete pipeline;
+            }
+            if ( verifier != nullptr) {
+                result = verifier->finish() > 0 ? 1 : 0;
+                delete verifier;
+                verifier = nullptr;
+            }
+            if ( binary_manifest != nullptr) {
+                binary_manifest->close();
+                delete binary_manifest;
+                binary_manifest = nullptr;
+            }
+            if ( hash_cache != nullptr) {
+                hash_cache->close();
+                delete hash_cache;
+            }
+            delete hard_links;
+            hard_links = nullptr;
+#endif
+            writeDone();
         }
         else {
             char* progName = strrchr(argv[0], path_separator) ? strrchr(argv[0], path_separator) + 1 : argv[0];
             printf("%s V0.1.0.3 by M. Gerodetti - compute the sha256 hash of each file in the path tree\n", argv[0]);
-            printf("syntax: %s <path>\n", progName);
+            Options::usage(progName);
         }
     }
     catch (const Exception ex) {
         text_buffer.reset() << ex;
         fputs(text_buffer.reader().begin(), stderr);
     }
+    catch (const Exception* ex) {  // the libs throw new _Exception(..)
+        text_buffer.reset() << *ex;
+        fputs(text_buffer.reader().begin(), stderr);
+    }
+    return result;
 }